@@ -0,0 +1,88 @@
+// Compares the precomputed gradient tables against the sinf/cosf reference:
+// throughput of each noise path and the height error the tables introduce.
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "noise.h"
+#include "timer.h"
+
+#define SIDE 1024
+#define SAMPLES (SIDE * SIDE)
+#define STEP 0.37f
+
+double time_noise(float *out) {
+    double start = get_time();
+
+    for (int j = 0; j < SIDE; j++)
+        for (int i = 0; i < SIDE; i++)
+            out[i + j * SIDE] = noise(i * STEP, j * STEP);
+
+    return (get_time() - start) * 1e9 / SAMPLES;
+}
+
+double time_batch(float *out) {
+    double start = get_time();
+
+    for (int j = 0; j < SIDE; j++)
+        noise_batch(out + j * SIDE, 0.0f, j * STEP, STEP, SIDE);
+
+    return (get_time() - start) * 1e9 / SAMPLES;
+}
+
+double time_grid(float *out) {
+    double start = get_time();
+    noise_grid(out, 0.0f, 0.0f, STEP, STEP, SIDE, SIDE);
+
+    return (get_time() - start) * 1e9 / SAMPLES;
+}
+
+int main() {
+    float *reference = (float *)malloc(sizeof(float) * SAMPLES);
+    float *out = (float *)malloc(sizeof(float) * SAMPLES);
+
+    init_noise();
+
+    set_noise_gradients(GRADIENTS_TRIG);
+    time_noise(reference);
+
+    printf("kernel: %s, %d samples at spacing %.2f\n\n", noise_kernel(), SAMPLES, STEP);
+    printf("%-12s %12s %12s %12s %12s %12s %12s\n", "gradients", "noise ns", "batch ns", "grid ns", "max error",
+           "rms error", "shade diff");
+
+    int modes[] = {GRADIENTS_TRIG, GRADIENTS_TABLE_256, GRADIENTS_TABLE_4096};
+
+    for (int m = 0; m < 3; m++) {
+        set_noise_gradients(modes[m]);
+
+        double noise_ns = time_noise(out);
+        double batch_ns = time_batch(out);
+        double grid_ns = time_grid(out);
+
+        // Error in terrain height, (noise + 1) / 2, and how many samples
+        // would land on a different 8-bit shade in the fragment shader
+        double max_error = 0, sum_sq = 0;
+        int shade_diff = 0;
+
+        for (int i = 0; i < SAMPLES; i++) {
+            double a = (reference[i] + 1.0) / 2.0;
+            double b = (out[i] + 1.0) / 2.0;
+            double e = fabs(a - b);
+
+            max_error = fmax(max_error, e);
+            sum_sq += e * e;
+
+            if (lround(a * 255) != lround(b * 255))
+                shade_diff++;
+        }
+
+        printf("%-12s %12.2f %12.2f %12.2f %12.2e %12.2e %11.3f%%\n", noise_gradients(), noise_ns, batch_ns, grid_ns,
+               max_error, sqrt(sum_sq / SAMPLES), 100.0 * shade_diff / SAMPLES);
+    }
+
+    free(reference);
+    free(out);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,253 @@
+// Micro-benchmarks for the libterrain hot paths. Every benchmark is warmed up,
+// then timed over several repetitions; the median and minimum per-operation
+// cost are reported as JSON (default) or CSV so runs can be diffed across commits.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "chunk.h"
+#include "fractal.h"
+#include "heightfield.h"
+#include "noise.h"
+#include "timer.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_CYCLES
+#endif
+
+#define REPETITIONS 15
+#define WARMUP 3
+#define SIDE 256
+
+struct _benchmark_t {
+    const char *name, *unit;
+    int ops;  // operations per repetition
+    void (*run)();
+
+    int fractal, octaves;  // octaves 0 keeps the default single octave
+};
+
+typedef struct _benchmark_t benchmark_t;
+
+volatile float sink;
+float *samples;
+u_int16_t *indices;
+
+tiles_t tiles;  // disabled, chunks are always generated
+job_t chunk_job = {.chunk_x = 3, .chunk_z = -5, .context = &tiles};
+
+void run_noise() {
+    float sum = 0;
+
+    for (int j = 0; j < SIDE; j++)
+        for (int i = 0; i < SIDE; i++)
+            sum += noise(i * 0.37f, j * 0.37f);
+
+    sink = sum;
+}
+
+void run_noise_batch() {
+    for (int j = 0; j < SIDE; j++)
+        noise_batch(samples + j * SIDE, 0.0f, j * 0.37f, 0.37f, SIDE);
+
+    sink = samples[SIDE * SIDE - 1];
+}
+
+void run_noise_grid() {
+    noise_grid(samples, 0.0f, 0.0f, 0.37f, 0.37f, SIDE, SIDE);
+    sink = samples[SIDE * SIDE - 1];
+}
+
+void run_grad() {
+    float sum = 0, v[2];
+
+    for (int j = 0; j < SIDE; j++)
+        for (int i = 0; i < SIDE; i++) {
+            grad(v, i, j);
+            sum += v[0];
+        }
+
+    sink = sum;
+}
+
+void run_fade() {
+    float sum = 0;
+
+    for (int i = 0; i < SIDE * SIDE; i++)
+        sum += fade(i * (1.0f / (SIDE * SIDE)));
+
+    sink = sum;
+}
+
+void run_fractal_grid() {
+    fractal_grid(samples, 0.0f, 0.0f, 0.37f, 0.37f, SIDE, SIDE);
+    sink = samples[SIDE * SIDE - 1];
+}
+
+void run_chunk() {
+    terrain_generate_heights(3, -5, samples);
+    sink = samples[0];
+}
+
+void run_level_1() {
+    terrain_generate_level_rows(3, -5, 1, 0, CHUNK_MIP_SIDE(1), samples);
+    sink = samples[0];
+}
+
+void run_level_2() {
+    terrain_generate_level_rows(3, -5, 2, 0, CHUNK_MIP_SIDE(2), samples);
+    sink = samples[0];
+}
+
+void run_level_3() {
+    terrain_generate_level_rows(3, -5, 3, 0, CHUNK_MIP_SIDE(3), samples);
+    sink = samples[0];
+}
+
+void run_chunk_data() {
+    // Sampling, encoding and the pyramid, as a chunk job does them
+    generate_chunk(&chunk_job);
+    sink = chunk_job.max_height;
+}
+
+void run_indices() {
+    terrain_generate_indices(indices);
+    sink = indices[CHUNK_INDICES - 1];
+}
+
+benchmark_t benchmarks[] = {
+    {"noise", "sample", SIDE * SIDE, run_noise},
+    {"noise_batch", "sample", SIDE * SIDE, run_noise_batch},
+    {"noise_grid", "sample", SIDE * SIDE, run_noise_grid},
+    {"grad", "call", SIDE * SIDE, run_grad},
+    {"fade", "call", SIDE * SIDE, run_fade},
+    {"generate_chunk", "sample", CHUNK_SIZE_1_SQ, run_chunk},
+    // Fractal costs are per octave of each sample
+    {"fbm_1", "octave", SIDE * SIDE * 1, run_fractal_grid, FRACTAL_FBM, 1},
+    {"fbm_2", "octave", SIDE * SIDE * 2, run_fractal_grid, FRACTAL_FBM, 2},
+    {"fbm_4", "octave", SIDE * SIDE * 4, run_fractal_grid, FRACTAL_FBM, 4},
+    {"fbm_8", "octave", SIDE * SIDE * 8, run_fractal_grid, FRACTAL_FBM, 8},
+    {"fbm_12", "octave", SIDE * SIDE * 12, run_fractal_grid, FRACTAL_FBM, 12},
+    {"ridged_4", "octave", SIDE * SIDE * 4, run_fractal_grid, FRACTAL_RIDGED, 4},
+    {"billow_4", "octave", SIDE * SIDE * 4, run_fractal_grid, FRACTAL_BILLOW, 4},
+    {"generate_chunk_fbm_4", "octave", CHUNK_SIZE_1_SQ * 4, run_chunk, FRACTAL_FBM, 4},
+    // Whole chunks sampled directly at a coarser level, octaves above Nyquist left out
+    {"generate_chunk_fbm_4_level_0", "chunk", 1, run_chunk, FRACTAL_FBM, 4},
+    {"generate_chunk_fbm_4_level_1", "chunk", 1, run_level_1, FRACTAL_FBM, 4},
+    {"generate_chunk_fbm_4_level_2", "chunk", 1, run_level_2, FRACTAL_FBM, 4},
+    {"generate_chunk_fbm_4_level_3", "chunk", 1, run_level_3, FRACTAL_FBM, 4},
+    {"generate_chunk_data_fbm_4", "chunk", 1, run_chunk_data, FRACTAL_FBM, 4},
+    {"generate_indices", "index", CHUNK_INDICES, run_indices},
+};
+
+int compare_doubles(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+void measure(benchmark_t *benchmark, int repetitions, double *median_ns, double *min_ns, double *median_cycles) {
+    double *ns = (double *)malloc(sizeof(double) * repetitions);
+    double *cycles = (double *)malloc(sizeof(double) * repetitions);
+
+    fractal_t fractal = {benchmark->fractal, benchmark->octaves ? benchmark->octaves : 1, 2.0f, 0.5f};
+    set_fractal(&fractal);
+
+    for (int i = 0; i < WARMUP; i++)
+        benchmark->run();
+
+    for (int i = 0; i < repetitions; i++) {
+        double start = get_time();
+#ifdef HAVE_CYCLES
+        unsigned long long start_cycles = __rdtsc();
+#endif
+
+        benchmark->run();
+
+#ifdef HAVE_CYCLES
+        cycles[i] = (double)(__rdtsc() - start_cycles) / benchmark->ops;
+#else
+        cycles[i] = 0;
+#endif
+        ns[i] = (get_time() - start) * 1e9 / benchmark->ops;
+    }
+
+    qsort(ns, repetitions, sizeof(double), compare_doubles);
+    qsort(cycles, repetitions, sizeof(double), compare_doubles);
+
+    *median_ns = ns[repetitions / 2];
+    *min_ns = ns[0];
+    *median_cycles = cycles[repetitions / 2];
+
+    free(ns);
+    free(cycles);
+}
+
+int main(int argc, char **argv) {
+    int csv = 0, repetitions = REPETITIONS;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--csv")) {
+            csv = 1;
+        } else if (!strcmp(argv[i], "--repetitions") && i + 1 < argc && atoi(argv[i + 1]) > 0) {
+            repetitions = atoi(argv[++i]);
+        } else {
+            fprintf(stderr, "Usage: %s [--csv] [--repetitions N]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    init_noise();
+
+    samples = (float *)malloc(sizeof(float) * (SIDE * SIDE > CHUNK_SIZE_1_SQ ? SIDE * SIDE : CHUNK_SIZE_1_SQ));
+    indices = (u_int16_t *)malloc(sizeof(u_int16_t) * CHUNK_INDICES);
+
+    init_tiles(&tiles, NULL, sizeof(height_t), CHUNK_DATA_SAMPLES);
+    chunk_job.data = malloc(sizeof(height_t) * CHUNK_DATA_SAMPLES);
+
+    // Cycles are time-stamp counter ticks, so they track wall time at the nominal clock
+#ifdef HAVE_CYCLES
+    const char *cycles_format = "%.2f";
+#else
+    const char *cycles_format = "null";
+#endif
+
+    int count = sizeof(benchmarks) / sizeof(benchmarks[0]);
+
+    if (csv)
+        printf("name,unit,ops,median_ns,min_ns,ops_per_sec,median_cycles\n");
+    else
+        printf("{\n  \"kernel\": \"%s\",\n  \"gradients\": \"%s\",\n  \"repetitions\": %d,\n  \"results\": [\n",
+               noise_kernel(), noise_gradients(), repetitions);
+
+    for (int i = 0; i < count; i++) {
+        benchmark_t *benchmark = &benchmarks[i];
+
+        double median_ns, min_ns, median_cycles;
+        measure(benchmark, repetitions, &median_ns, &min_ns, &median_cycles);
+
+        if (csv) {
+            printf("%s,%s,%d,%.3f,%.3f,%.0f,", benchmark->name, benchmark->unit, benchmark->ops, median_ns, min_ns,
+                   1e9 / median_ns);
+            printf(cycles_format, median_cycles);
+            printf("\n");
+        } else {
+            printf("    {\"name\": \"%s\", \"unit\": \"%s\", \"ops\": %d, \"median_ns\": %.3f, \"min_ns\": %.3f, "
+                   "\"ops_per_sec\": %.0f, \"median_cycles\": ",
+                   benchmark->name, benchmark->unit, benchmark->ops, median_ns, min_ns, 1e9 / median_ns);
+            printf(cycles_format, median_cycles);
+            printf("}%s\n", i + 1 < count ? "," : "");
+        }
+    }
+
+    if (!csv)
+        printf("  ]\n}\n");
+
+    free(samples);
+    free(indices);
+    free(chunk_job.data);
+    free_tiles(&tiles);
+
+    return EXIT_SUCCESS;
+}
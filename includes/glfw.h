@@ -1,4 +1,5 @@
 #define GL_SILENCE_DEPRECATION
 #define GLFW_INCLUDE_GLCOREARB
+#define GL_GLEXT_PROTOTYPES  // core profile prototypes from GL/glcorearb.h on Linux
 
 #include <GLFW/glfw3.h>
\ No newline at end of file
@@ -0,0 +1,50 @@
+#version 330 core
+
+uniform mat4 view, projection;
+uniform sampler2DArray heights;
+
+uniform int level;
+uniform ivec2 origin;  // lattice coordinates of vertex (0, 0) in this level
+uniform float spacing;
+uniform bool morph;
+
+out vec3 vecPosition;
+
+// CLIPMAP_SIDE and CLIPMAP_TEXTURE in clipmap.h
+const int side = 253;
+const int textureSide = 256;
+
+// Cells from the level's edge over which heights blend into the next level
+const int transition = 16;
+
+float height(ivec2 lattice)
+{
+    ivec2 texel = lattice & (textureSide - 1);
+    return texelFetch(heights, ivec3(texel, level), 0).r;
+}
+
+void main()
+{
+    ivec2 cell = ivec2(gl_VertexID % side, gl_VertexID / side);
+    ivec2 lattice = origin + cell;
+
+    float h = height(lattice);
+
+    if (morph) {
+        int edge = min(min(cell.x, cell.y), min(side - 1 - cell.x, side - 1 - cell.y));
+        float alpha = clamp(float(transition - edge) / float(transition), 0.0, 1.0);
+
+        // The next level only has the even lattice points: its surface is the
+        // midpoint of the two on either side, across the anti-diagonal when both are odd
+        ivec2 odd = lattice & 1;
+        ivec2 across = ivec2(odd.x, -odd.y);
+        float coarse = (height(lattice - across) + height(lattice + across)) * 0.5;
+
+        h = mix(h, coarse, alpha);
+    }
+
+    vec3 position = vec3(float(lattice.x) * spacing, h, float(lattice.y) * spacing);
+
+    gl_Position = projection * view * vec4(position, 1.0);
+    vecPosition = position;
+}
@@ -0,0 +1,40 @@
+#version 330 core
+
+uniform mat4 view, projection;
+uniform sampler2DArray heights;
+uniform vec3 camera;
+
+uniform int slot;      // texture layer with this node's heights
+uniform vec2 origin;   // world position of vertex (0, 0)
+uniform float spacing;
+uniform vec2 morph;    // distance where morphing starts, and 1 / its length
+
+out vec3 vecPosition;
+
+// QUADTREE_PATCH_1 in quadtree.h
+const int patchSide = 33;
+
+float height(ivec2 cell)
+{
+    return texelFetch(heights, ivec3(cell, slot), 0).r;
+}
+
+void main()
+{
+    ivec2 cell = ivec2(gl_VertexID % patchSide, gl_VertexID / patchSide);
+    vec2 xz = origin + vec2(cell) * spacing;
+
+    float h = height(cell);
+    float alpha = clamp((distance(camera, vec3(xz.x, h, xz.y)) - morph.x) * morph.y, 0.0, 1.0);
+
+    // The next level only has the even cells: its surface is the midpoint of
+    // the two on either side, across the anti-diagonal when both are odd
+    ivec2 odd = cell & 1;
+    ivec2 across = ivec2(odd.x, -odd.y);
+    float coarse = (height(cell - across) + height(cell + across)) * 0.5;
+
+    vec3 position = vec3(xz.x, mix(h, coarse, alpha), xz.y);
+
+    gl_Position = projection * view * vec4(position, 1.0);
+    vecPosition = position;
+}
@@ -1,13 +1,51 @@
 #version 330 core
 
-layout(location = 0) in vec3 position;
+layout(location = 0) in float height;
 
 uniform mat4 view, projection;
+uniform vec2 origin;
+uniform int gridVertices;  // chunkSide * chunkSide, plus the averaged pyramid levels with LOD on
+uniform int slotVertices;  // gridVertices, plus the skirt vertices when there are any
 
 out vec3 vecPosition;
 
+// Vertices per chunk side, CHUNK_SIZE_1 in heightfield.h
+const int chunkSide = 129;
+
+// Deep enough to cover any crack, heights span [0, 1]
+const float skirtDepth = 1.0;
+
 void main()
 {
+    int i = gl_VertexID % slotVertices;
+    vec3 position;
+
+    if (i < gridVertices) {
+        // Each pyramid level has half the cells a side of the one before, see chunk_mip_offset
+        int level = 0, side = chunkSide;
+        while (i >= side * side) {
+            i -= side * side;
+            side = side / 2 + 1;
+            level++;
+        }
+
+        float spacing = float(1 << level);
+        position = vec3(origin.x + float(i % side) * spacing, height, origin.y - float(i / side) * spacing);
+    } else {
+        // Skirts: chunkSide copies of each edge in CHUNK_EDGE_* order, left, right, top, bottom
+        int skirt = i - gridVertices;
+        int edge = skirt / chunkSide;
+        float along = float(skirt % chunkSide);
+        float last = float(chunkSide - 1);
+
+        vec2 cell = edge == 0 ? vec2(0.0, along)
+                  : edge == 1 ? vec2(last, along)
+                  : edge == 2 ? vec2(along, 0.0)
+                              : vec2(along, last);
+
+        position = vec3(origin.x + cell.x, height - skirtDepth, origin.y - cell.y);
+    }
+
     gl_Position = projection * view * vec4(position, 1.0);
     vecPosition = position;
 }
@@ -0,0 +1,178 @@
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BENCH_SPEED 2.0f      // units per frame, independent of frame time
+#define BENCH_ALTITUDE 10.0f
+#define BENCH_PITCH -0.3f
+
+const char *bench_paths[] = {"line", "spiral", "zigzag"};
+
+int parse_bench_path(const char *name) {
+    for (int i = 0; i < 3; i++)
+        if (!strcmp(name, bench_paths[i]))
+            return i;
+
+    return BENCH_NONE;
+}
+
+void init_bench(bench_t *bench, int path, int frames) {
+    bench->path = path;
+    bench->frames = frames;
+    bench->frame = 0;
+    bench->frame_times = (double *)malloc(sizeof(double) * frames);
+}
+
+void free_bench(bench_t *bench) {
+    free(bench->frame_times);
+}
+
+void bench_position(int path, int frame, vec3 pos) {
+    float d = frame * BENCH_SPEED;
+
+    switch (path) {
+        case BENCH_LINE:
+            // Diagonal, so both x and z chunk boundaries are crossed
+            vec3_set(pos, d * 0.6f, BENCH_ALTITUDE, -d * 0.8f);
+            break;
+
+        case BENCH_SPIRAL: {
+            // Archimedean spiral r = b * a at roughly constant speed, 64 units between turns
+            float b = 64.0f / (2.0f * M_PI);
+            float a = sqrtf(2.0f * d / b);
+            vec3_set(pos, b * a * cosf(a), BENCH_ALTITUDE, b * a * sinf(a));
+            break;
+        }
+
+        case BENCH_ZIGZAG: {
+            // Forward along -z while sweeping x back and forth across the x = 0 and x = +-128 boundaries
+            float t = fmodf(d * 0.7f, 640.0f);
+            float x = t < 320.0f ? t - 160.0f : 480.0f - t;
+            vec3_set(pos, x, BENCH_ALTITUDE, -d * 0.7f);
+            break;
+        }
+    }
+}
+
+void bench_camera(bench_t *bench, vec3 pos, float *yaw, float *pitch) {
+    vec3 next;
+    bench_position(bench->path, bench->frame, pos);
+    bench_position(bench->path, bench->frame + 1, next);
+
+    // Look along the direction of travel
+    *yaw = atan2f(next[0] - pos[0], pos[2] - next[2]);
+    *pitch = BENCH_PITCH;
+}
+
+void record_frame(bench_t *bench, double time) {
+    bench->frame_times[bench->frame++] = time;
+}
+
+int compare_times(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+double percentile(double *sorted, int count, double p) {
+    int i = (int)(p * (count - 1) + 0.5);
+    return sorted[i];
+}
+
+void print_frame_times(double *sorted, int count, double total) {
+    printf("frame ms: mean %.3f, p50 %.3f, p90 %.3f, p99 %.3f, max %.3f\n", total * 1e3 / count,
+           percentile(sorted, count, 0.50) * 1e3, percentile(sorted, count, 0.90) * 1e3,
+           percentile(sorted, count, 0.99) * 1e3, sorted[count - 1] * 1e3);
+}
+
+void report_bench(bench_t *bench, terrain_t *terrain, clipmap_t *clipmap, quadtree_t *quadtree) {
+    int count = bench->frame;
+    if (count == 0)
+        return;
+
+    double *sorted = (double *)malloc(sizeof(double) * count);
+    memcpy(sorted, bench->frame_times, sizeof(double) * count);
+    qsort(sorted, count, sizeof(double), compare_times);
+
+    double total = 0;
+    for (int i = 0; i < count; i++)
+        total += sorted[i];
+
+    if (clipmap) {
+        printf("bench: %s path, %d frames, %d clipmap levels, %s\n", bench_paths[bench->path], count,
+               clipmap->levels, glGetString(GL_RENDERER));
+        print_frame_times(sorted, count, total);
+        printf("clipmap: %ld texels updated, %.1f per frame\n", clipmap->texels_updated,
+               (double)clipmap->texels_updated / count);
+        printf("update ms: total %.3f, per frame %.3f\n", clipmap->update_time * 1e3,
+               clipmap->update_time * 1e3 / count);
+
+        free(sorted);
+        return;
+    }
+
+    if (quadtree) {
+        cache_t *cache = &quadtree->cache;
+
+        printf("bench: %s path, %d frames, %d quadtree levels, %s\n", bench_paths[bench->path], count,
+               quadtree->levels, glGetString(GL_RENDERER));
+        print_frame_times(sorted, count, total);
+        printf("nodes: %d drawn, %d culled, %d deferred in the last frame\n", quadtree->nodes_drawn,
+               quadtree->nodes_culled, quadtree->nodes_deferred);
+        printf("patches: %d hits, %d misses, %d evictions, %d of %d slots used\n", cache->hits, cache->misses,
+               cache->evictions, cache->count, cache->capacity);
+        printf("generate ms: total %.3f, per node %.3f\n", quadtree->generate_time * 1e3,
+               quadtree->nodes_generated ? quadtree->generate_time * 1e3 / quadtree->nodes_generated : 0.0);
+
+        free(sorted);
+        return;
+    }
+
+    int uploaded = terrain->chunks_uploaded;
+    cache_t *cache = &terrain->cache;
+
+    printf("bench: %s path, %d frames, %dx%d chunks, %s\n", bench_paths[bench->path], count, terrain->side,
+           terrain->side, glGetString(GL_RENDERER));
+    print_frame_times(sorted, count, total);
+    printf("chunks: %d generated, %d uploaded, %d discarded, %d cancelled, %d prefetched, %d re-centers\n",
+           terrain->chunks_generated, uploaded, terrain->chunks_discarded, terrain->chunks_cancelled,
+           terrain->chunks_prefetched, terrain->recenters);
+    printf("cache: %d hits, %d misses, %d evictions, %d of %d entries used\n", cache->hits, cache->misses,
+           cache->evictions, cache->count, cache->capacity);
+    if (terrain->tiles.dir)
+        printf("tiles: %d loaded, %d stored, %d rejected\n", terrain->tiles.loaded, terrain->tiles.stored,
+               terrain->tiles.rejected);
+    printf("generate ms: total %.3f, per chunk %.3f (worker time)\n", terrain->generate_time * 1e3,
+           terrain->chunks_generated ? terrain->generate_time * 1e3 / terrain->chunks_generated : 0.0);
+    printf("upload ms: total %.3f, per chunk %.3f (%s staging, %d stalls)\n", terrain->upload_time * 1e3,
+           uploaded ? terrain->upload_time * 1e3 / uploaded : 0.0, staging_mode(&terrain->staging),
+           terrain->staging.stalls);
+
+    if (terrain->lod != LOD_OFF) {
+        int grid = terrain->grid_indices_drawn;
+        size_t plain_vertices = terrain_vertex_bytes(terrain) / terrain->slot_vertices * CHUNK_SIZE_1_SQ;
+
+        printf("lod: %s, %d indices drawn last frame (%+.1f%% over the plain grids), %.1f MB of indices, "
+               "%.1f MB of vertices (%+.1f%%)\n",
+               chunk_lod_name(terrain->lod), terrain->indices_drawn,
+               grid ? (terrain->indices_drawn - grid) * 100.0 / grid : 0.0, terrain->index_bytes / (1024.0 * 1024.0),
+               terrain_vertex_bytes(terrain) / (1024.0 * 1024.0),
+               (terrain_vertex_bytes(terrain) - plain_vertices) * 100.0 / plain_vertices);
+
+        // Far chunks are sampled directly at the level they are drawn at
+        fractal_t fractal;
+        get_fractal(&fractal);
+
+        for (int level = 0; level < CHUNK_LODS; level++) {
+            int chunks = terrain->level_chunks[level], side = CHUNK_MIP_SIDE(level);
+            int octaves = chunk_level_octaves(level) < fractal.octaves ? chunk_level_octaves(level) : fractal.octaves;
+
+            printf("level %d: %d chunks generated, %ld samples (%d per chunk, %d of %d octaves), %.3f ms per chunk\n",
+                   level, chunks, terrain->level_samples[level], side * side, octaves, fractal.octaves,
+                   chunks ? terrain->level_time[level] * 1e3 / chunks : 0.0);
+        }
+    }
+
+    free(sorted);
+}
@@ -0,0 +1,40 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include "clipmap.h"
+#include "linmath.h"
+#include "quadtree.h"
+#include "terrain.h"
+
+#define BENCH_FRAMES 2000
+#define BENCH_WIDTH 800
+#define BENCH_HEIGHT 600
+#define BENCH_FRAME_TIME (1.0f / 60.0f)  // seconds a scripted frame stands for, whatever it takes to draw
+
+enum {
+    BENCH_NONE = -1,
+    BENCH_LINE,
+    BENCH_SPIRAL,
+    BENCH_ZIGZAG,
+};
+
+struct _bench_t {
+    int path;
+    int frames, frame;
+
+    double *frame_times;
+};
+
+typedef struct _bench_t bench_t;
+
+int parse_bench_path(const char *name);
+
+void init_bench(bench_t *bench, int path, int frames);
+void free_bench(bench_t *bench);
+
+void bench_camera(bench_t *bench, vec3 pos, float *yaw, float *pitch);
+void record_frame(bench_t *bench, double time);
+// Reports on whichever of terrain, clipmap and quadtree was drawn, the others are NULL
+void report_bench(bench_t *bench, terrain_t *terrain, clipmap_t *clipmap, quadtree_t *quadtree);
+
+#endif  // BENCH_H
@@ -0,0 +1,145 @@
+#include "cache.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+unsigned int cache_hash(int chunk_x, int chunk_z);
+void unlink_entry(cache_t *cache, cache_entry_t *entry);
+void push_entry(cache_t *cache, cache_entry_t *entry);
+
+void init_cache(cache_t *cache, size_t budget, size_t entry_size) {
+    cache->entry_size = entry_size;
+    cache->capacity = (int)(budget / entry_size);
+    cache->count = 0;
+
+    cache->head = cache->tail = NULL;
+    cache->hits = cache->misses = cache->evictions = 0;
+
+    // Power of two buckets, at least one per entry
+    unsigned int buckets = 1;
+    while (buckets < (unsigned int)cache->capacity)
+        buckets <<= 1;
+
+    cache->buckets_mask = buckets - 1;
+    cache->buckets = (cache_entry_t **)calloc(buckets, sizeof(cache_entry_t *));
+
+    cache->entries = (cache_entry_t *)malloc(sizeof(cache_entry_t) * (cache->capacity ? cache->capacity : 1));
+    cache->buffers = malloc(entry_size * (cache->capacity ? cache->capacity : 1));
+
+    if (!cache->buckets || !cache->entries || !cache->buffers) {
+        fprintf(stderr, "Error: unable to allocate %zu bytes of chunk cache\n", budget);
+        exit(EXIT_FAILURE);
+    }
+
+    for (int i = 0; i < cache->capacity; i++)
+        cache->entries[i].data = (char *)cache->buffers + entry_size * i;
+}
+
+void free_cache(cache_t *cache) {
+    free(cache->buckets);
+    free(cache->entries);
+    free(cache->buffers);
+}
+
+cache_entry_t *find_cached(cache_t *cache, int chunk_x, int chunk_z) {
+    cache_entry_t *entry = cache->buckets[cache_hash(chunk_x, chunk_z) & cache->buckets_mask];
+
+    while (entry && (entry->chunk_x != chunk_x || entry->chunk_z != chunk_z))
+        entry = entry->bucket_next;
+
+    if (!entry) {
+        miss_cached(cache);
+        return NULL;
+    }
+
+    cache->hits++;
+
+    unlink_entry(cache, entry);
+    push_entry(cache, entry);
+
+    return entry;
+}
+
+cache_entry_t *peek_cached(cache_t *cache, int chunk_x, int chunk_z) {
+    cache_entry_t *entry = cache->buckets[cache_hash(chunk_x, chunk_z) & cache->buckets_mask];
+
+    while (entry && (entry->chunk_x != chunk_x || entry->chunk_z != chunk_z))
+        entry = entry->bucket_next;
+
+    return entry;
+}
+
+void miss_cached(cache_t *cache) {
+    if (cache->capacity > 0)
+        cache->misses++;
+}
+
+cache_entry_t *insert_cached(cache_t *cache, int chunk_x, int chunk_z) {
+    if (cache->capacity == 0)
+        return NULL;
+
+    unsigned int bucket = cache_hash(chunk_x, chunk_z) & cache->buckets_mask;
+
+    // Already cached, e.g. a chunk generated twice while its first result was in flight
+    cache_entry_t *entry = cache->buckets[bucket];
+    while (entry && (entry->chunk_x != chunk_x || entry->chunk_z != chunk_z))
+        entry = entry->bucket_next;
+
+    if (entry) {
+        unlink_entry(cache, entry);
+        push_entry(cache, entry);
+        return entry;
+    }
+
+    if (cache->count < cache->capacity) {
+        entry = &cache->entries[cache->count++];
+    } else {
+        entry = cache->tail;
+        unlink_entry(cache, entry);
+
+        // Drop the evicted entry from its bucket chain
+        cache_entry_t **link = &cache->buckets[cache_hash(entry->chunk_x, entry->chunk_z) & cache->buckets_mask];
+        while (*link != entry)
+            link = &(*link)->bucket_next;
+        *link = entry->bucket_next;
+
+        cache->evictions++;
+    }
+
+    entry->chunk_x = chunk_x;
+    entry->chunk_z = chunk_z;
+
+    entry->bucket_next = cache->buckets[bucket];
+    cache->buckets[bucket] = entry;
+
+    push_entry(cache, entry);
+    return entry;
+}
+
+unsigned int cache_hash(int chunk_x, int chunk_z) {
+    return (unsigned int)chunk_x * 73856093u ^ (unsigned int)chunk_z * 19349663u;
+}
+
+void unlink_entry(cache_t *cache, cache_entry_t *entry) {
+    if (entry->prev)
+        entry->prev->next = entry->next;
+    else
+        cache->head = entry->next;
+
+    if (entry->next)
+        entry->next->prev = entry->prev;
+    else
+        cache->tail = entry->prev;
+}
+
+void push_entry(cache_t *cache, cache_entry_t *entry) {
+    entry->prev = NULL;
+    entry->next = cache->head;
+
+    if (cache->head)
+        cache->head->prev = entry;
+    else
+        cache->tail = entry;
+
+    cache->head = entry;
+}
@@ -0,0 +1,56 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+// LRU cache of generated chunk data keyed by chunk coordinates, part of
+// libterrain. Not thread safe: only the thread that owns the terrain uses it.
+
+#include <stddef.h>
+
+struct _cache_entry_t {
+    int chunk_x, chunk_z;
+
+    void *data;  // entry_size bytes, owned by the cache
+    float min_height, max_height;
+
+    struct _cache_entry_t *prev, *next;  // LRU list, most recently used first
+    struct _cache_entry_t *bucket_next;
+};
+
+typedef struct _cache_entry_t cache_entry_t;
+
+struct _cache_t {
+    cache_entry_t *entries;
+    void *buffers;
+    size_t entry_size;
+    int capacity, count;
+
+    cache_entry_t **buckets;
+    unsigned int buckets_mask;
+
+    cache_entry_t *head, *tail;
+
+    // Totals since init
+    int hits, misses, evictions;
+};
+
+typedef struct _cache_t cache_t;
+
+// Holds as many entries as fit in budget bytes, a budget of 0 disables the cache
+void init_cache(cache_t *cache, size_t budget, size_t entry_size);
+void free_cache(cache_t *cache);
+
+// Returns the entry and marks it most recently used, or NULL on a miss
+cache_entry_t *find_cached(cache_t *cache, int chunk_x, int chunk_z);
+
+// The same without counting a hit or miss or touching the LRU order
+cache_entry_t *peek_cached(cache_t *cache, int chunk_x, int chunk_z);
+
+// Counts a miss found with peek_cached, once the caller acts on it. Misses,
+// like hits and evictions, are only counted while the cache is enabled.
+void miss_cached(cache_t *cache);
+
+// Returns the entry to fill for the chunk, evicting the least recently used
+// one when full. NULL when the cache is disabled.
+cache_entry_t *insert_cached(cache_t *cache, int chunk_x, int chunk_z);
+
+#endif  // CACHE_H
@@ -0,0 +1,54 @@
+#include "chunk.h"
+
+#include <string.h>
+
+int generate_chunk_block(job_t *job) {
+    tiles_t *tiles = (tiles_t *)job->context;
+    height_t *data = (height_t *)job->data;
+
+    // A chunk sampled at a coarser level fills the buffer from that level on
+    int first = chunk_mip_offset(job->level);
+
+    if (job->progress == 0) {
+        job->loaded = load_tile(tiles, job->chunk_x, job->chunk_z, job->level, data + first,
+                                CHUNK_DATA_SAMPLES - first, &job->min_height, &job->max_height);
+        if (job->loaded)
+            return 1;
+
+        // Cells of the levels below are stored and cached along with the rest,
+        // clear what an earlier chunk left in the pooled buffer
+        for (int level = 1; level < job->level; level++) {
+            size_t cells = (CHUNK_SIZE >> level) * (CHUNK_SIZE >> level);
+            memset(data + chunk_bounds_offset(level, 0), 0, sizeof(height_t) * cells);
+            memset(data + chunk_bounds_offset(level, 1), 0, sizeof(height_t) * cells);
+        }
+    }
+
+    // Far chunks are sampled straight into the level they are drawn at
+    int side = CHUNK_MIP_SIDE(job->level);
+    int count = side - job->progress < CHUNK_BLOCK_ROWS ? side - job->progress : CHUNK_BLOCK_ROWS;
+    int offset = first + job->progress * side;
+
+    float samples[CHUNK_SIZE_1 * CHUNK_BLOCK_ROWS];
+    terrain_generate_level_rows(job->chunk_x, job->chunk_z, job->level, job->progress, count, samples);
+
+    for (int i = 0; i < side * count; i++)
+        data[offset + i] = ENCODE_HEIGHT(samples[i]);
+
+    job->progress += count;
+    if (job->progress < side)
+        return 0;
+
+    // The pyramid comes from the encoded heights, so its bounds hold for what is drawn
+    generate_pyramid(data, job->level, &job->min_height, &job->max_height);
+
+    store_tile(tiles, job->chunk_x, job->chunk_z, job->level, data + first, CHUNK_DATA_SAMPLES - first,
+               job->min_height, job->max_height);
+    return 1;
+}
+
+void generate_chunk(job_t *job) {
+    job->progress = 0;
+    while (!generate_chunk_block(job))
+        ;
+}
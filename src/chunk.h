@@ -0,0 +1,28 @@
+#ifndef CHUNK_H
+#define CHUNK_H
+
+// Assembles a chunk's data, part of libterrain: samples of the level the
+// chunk is generated at, encoded as height_t, with the pyramid built on them,
+// read from and written to tiles on the way. CPU only, safe on worker threads.
+
+#include "jobs.h"
+#include "pyramid.h"
+#include "tiles.h"
+
+// Rows sampled per step, one noise lattice cell at full resolution, so each
+// step hashes a lattice row once and the sample buffer stays small
+#define CHUNK_BLOCK_ROWS GRID_SIZE
+
+// For jobs whose buffer holds CHUNK_DATA_SAMPLES height_t and whose context
+// is a tiles_t, disabled or not. The chunk fills the buffer from
+// chunk_mip_offset(job->level) on, and job->min_height and max_height end up
+// bounding it.
+//
+// generate_chunk_block does the next CHUNK_BLOCK_ROWS rows, or loads the
+// whole chunk from its tile on the first call, and returns 1 once the chunk is
+// complete. Start with job->progress at 0. generate_chunk does a whole chunk
+// and is a job_func_t.
+int generate_chunk_block(job_t *job);
+void generate_chunk(job_t *job);
+
+#endif  // CHUNK_H
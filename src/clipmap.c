@@ -0,0 +1,215 @@
+#include "clipmap.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "heightfield.h"
+#include "timer.h"
+
+int generate_clipmap_indices(u_int16_t *indices, int hole_x, int hole_z, int hole_size);
+void update_level(clipmap_t *clipmap, int l, int origin_x, int origin_z);
+void update_region(clipmap_t *clipmap, int l, int x, int z, int width, int height);
+
+void init_clipmap(clipmap_t *clipmap, int levels) {
+    clipmap->levels = levels < MIN_CLIPMAP_LEVELS ? MIN_CLIPMAP_LEVELS
+                    : levels > MAX_CLIPMAP_LEVELS ? MAX_CLIPMAP_LEVELS
+                                                  : levels;
+
+    for (int l = 0; l < clipmap->levels; l++)
+        clipmap->level[l].valid = 0;
+
+    clipmap->samples = (float *)malloc(sizeof(float) * CLIPMAP_SIDE * CLIPMAP_SIDE);
+    clipmap->texels_updated = 0;
+    clipmap->update_time = 0;
+
+    // The full grid for the finest level, then every level outside it drawn as
+    // a ring around the one inside: that one sits CLIPMAP_HALF / 2 cells in,
+    // plus one on either axis depending on how the two levels snapped
+    int cells = CLIPMAP_SIDE - 1;
+    u_int16_t *indices = (u_int16_t *)malloc(sizeof(u_int16_t) * cells * cells * 6 * (1 + CLIPMAP_HOLE_VARIANTS));
+
+    clipmap->full_count = generate_clipmap_indices(indices, 0, 0, 0);
+
+    u_int16_t *ring = indices + clipmap->full_count;
+    for (int v = 0; v < CLIPMAP_HOLE_VARIANTS; v++) {
+        int hole_x = CLIPMAP_HALF / 2 + v % 2;
+        int hole_z = CLIPMAP_HALF / 2 + v / 2;
+
+        clipmap->ring_count = generate_clipmap_indices(ring, hole_x, hole_z, CLIPMAP_HALF);
+        ring += clipmap->ring_count;
+    }
+
+    // Positions come from gl_VertexID, so the VAO only carries the indices
+    glGenVertexArrays(1, &clipmap->vao);
+    glBindVertexArray(clipmap->vao);
+
+    glGenBuffers(1, &clipmap->ebo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, clipmap->ebo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(u_int16_t) * (ring - indices), indices, GL_STATIC_DRAW);
+
+    free(indices);
+
+    glGenTextures(1, &clipmap->texture);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, clipmap->texture);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_R32F, CLIPMAP_TEXTURE, CLIPMAP_TEXTURE, clipmap->levels, 0, GL_RED,
+                 GL_FLOAT, NULL);
+
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    init_noise();
+}
+
+void free_clipmap(clipmap_t *clipmap) {
+    free(clipmap->samples);
+
+    glDeleteVertexArrays(1, &clipmap->vao);
+    glDeleteBuffers(1, &clipmap->ebo);
+    glDeleteTextures(1, &clipmap->texture);
+}
+
+void update_clipmap(clipmap_t *clipmap, vec3 pos) {
+    double start = get_time();
+
+    for (int l = 0; l < clipmap->levels; l++) {
+        float spacing = (float)(1 << l);
+
+        // Snapped to even lattice points, so the next level's vertices are a
+        // subset of this one's
+        int origin_x = (int)floor((pos[0] / spacing - CLIPMAP_HALF) / 2.0) * 2;
+        int origin_z = (int)floor((pos[2] / spacing - CLIPMAP_HALF) / 2.0) * 2;
+
+        update_level(clipmap, l, origin_x, origin_z);
+    }
+
+    clipmap->update_time += get_time() - start;
+}
+
+void draw_clipmap(clipmap_t *clipmap, GLuint shader) {
+    glBindVertexArray(clipmap->vao);
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, clipmap->texture);
+
+    glUniform1i(glGetUniformLocation(shader, "heights"), 0);
+
+    GLint level_loc = glGetUniformLocation(shader, "level");
+    GLint origin_loc = glGetUniformLocation(shader, "origin");
+    GLint spacing_loc = glGetUniformLocation(shader, "spacing");
+    GLint morph_loc = glGetUniformLocation(shader, "morph");
+
+    // Finest first, so the depth test rejects most of what the rings hide
+    for (int l = 0; l < clipmap->levels; l++) {
+        clipmap_level_t *level = &clipmap->level[l];
+
+        glUniform1i(level_loc, l);
+        glUniform2i(origin_loc, level->origin_x, level->origin_z);
+        glUniform1f(spacing_loc, (float)(1 << l));
+
+        // The outermost level has nothing to blend into
+        glUniform1i(morph_loc, l + 1 < clipmap->levels);
+
+        if (l == 0) {
+            glDrawElements(GL_TRIANGLES, clipmap->full_count, GL_UNSIGNED_SHORT, (void *)0);
+            continue;
+        }
+
+        // Where the inner level sits in this one, in this level's cells
+        clipmap_level_t *inner = &clipmap->level[l - 1];
+        int hole_x = inner->origin_x / 2 - level->origin_x - CLIPMAP_HALF / 2;
+        int hole_z = inner->origin_z / 2 - level->origin_z - CLIPMAP_HALF / 2;
+
+        size_t offset = clipmap->full_count + (hole_x + hole_z * 2) * clipmap->ring_count;
+        glDrawElements(GL_TRIANGLES, clipmap->ring_count, GL_UNSIGNED_SHORT,
+                       (void *)(offset * sizeof(u_int16_t)));
+    }
+}
+
+float clipmap_view_distance(clipmap_t *clipmap) {
+    return CLIPMAP_HALF * (float)(1 << (clipmap->levels - 1));
+}
+
+int generate_clipmap_indices(u_int16_t *indices, int hole_x, int hole_z, int hole_size) {
+    int count = 0;
+
+    for (int j = 0; j < CLIPMAP_SIDE - 1; j++)
+        for (int i = 0; i < CLIPMAP_SIDE - 1; i++) {
+            if (i >= hole_x && i < hole_x + hole_size && j >= hole_z && j < hole_z + hole_size)
+                continue;
+
+            // Rows run towards +z here, so the winding is the reverse of a chunk's
+            indices[count++] = (i + 0) + (j + 0) * CLIPMAP_SIDE;
+            indices[count++] = (i + 0) + (j + 1) * CLIPMAP_SIDE;
+            indices[count++] = (i + 1) + (j + 0) * CLIPMAP_SIDE;
+            indices[count++] = (i + 1) + (j + 1) * CLIPMAP_SIDE;
+            indices[count++] = (i + 1) + (j + 0) * CLIPMAP_SIDE;
+            indices[count++] = (i + 0) + (j + 1) * CLIPMAP_SIDE;
+        }
+
+    return count;
+}
+
+void update_level(clipmap_t *clipmap, int l, int origin_x, int origin_z) {
+    clipmap_level_t *level = &clipmap->level[l];
+
+    int dx = origin_x - level->origin_x;
+    int dz = origin_z - level->origin_z;
+
+    if (level->valid && dx == 0 && dz == 0)
+        return;
+
+    if (!level->valid || abs(dx) >= CLIPMAP_SIDE || abs(dz) >= CLIPMAP_SIDE) {
+        update_region(clipmap, l, origin_x, origin_z, CLIPMAP_SIDE, CLIPMAP_SIDE);
+    } else {
+        // Only the strips that scrolled into view; texels wrap around so the rest stay put
+        if (dx > 0)
+            update_region(clipmap, l, level->origin_x + CLIPMAP_SIDE, origin_z, dx, CLIPMAP_SIDE);
+        if (dx < 0)
+            update_region(clipmap, l, origin_x, origin_z, -dx, CLIPMAP_SIDE);
+        if (dz > 0)
+            update_region(clipmap, l, origin_x, level->origin_z + CLIPMAP_SIDE, CLIPMAP_SIDE, dz);
+        if (dz < 0)
+            update_region(clipmap, l, origin_x, origin_z, CLIPMAP_SIDE, -dz);
+    }
+
+    level->origin_x = origin_x;
+    level->origin_z = origin_z;
+    level->valid = 1;
+}
+
+void update_region(clipmap_t *clipmap, int l, int x, int z, int width, int height) {
+    float spacing = (float)(1 << l);
+    terrain_generate_grid(x * spacing, z * spacing, spacing, width, height, clipmap->samples);
+
+    glBindTexture(GL_TEXTURE_2D_ARRAY, clipmap->texture);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, width);
+
+    // Lattice point (x, z) lives in texel (x, z) mod CLIPMAP_TEXTURE, so a
+    // region splits into at most four rectangles where it wraps
+    int tx = ((x % CLIPMAP_TEXTURE) + CLIPMAP_TEXTURE) % CLIPMAP_TEXTURE;
+    int tz = ((z % CLIPMAP_TEXTURE) + CLIPMAP_TEXTURE) % CLIPMAP_TEXTURE;
+
+    int widths[2] = {width < CLIPMAP_TEXTURE - tx ? width : CLIPMAP_TEXTURE - tx, 0};
+    int heights[2] = {height < CLIPMAP_TEXTURE - tz ? height : CLIPMAP_TEXTURE - tz, 0};
+    widths[1] = width - widths[0];
+    heights[1] = height - heights[0];
+
+    for (int b = 0; b < 2; b++)
+        for (int a = 0; a < 2; a++) {
+            if (!widths[a] || !heights[b])
+                continue;
+
+            glPixelStorei(GL_UNPACK_SKIP_PIXELS, a ? widths[0] : 0);
+            glPixelStorei(GL_UNPACK_SKIP_ROWS, b ? heights[0] : 0);
+
+            glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, a ? 0 : tx, b ? 0 : tz, l, widths[a], heights[b], 1, GL_RED,
+                            GL_FLOAT, clipmap->samples);
+        }
+
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
+    glPixelStorei(GL_UNPACK_SKIP_ROWS, 0);
+
+    clipmap->texels_updated += (long)width * height;
+}
@@ -0,0 +1,52 @@
+#ifndef CLIPMAP_H
+#define CLIPMAP_H
+
+#include "glfw.h"
+#include "linmath.h"
+
+// Geometry clipmap: nested square grids around the camera, each level with
+// twice the spacing of the one inside it. Level heights live in one layer of
+// a texture array that is updated toroidally as the camera moves.
+
+#define CLIPMAP_HALF 126                          // M: cells from the centre of a level to its edge, even
+#define CLIPMAP_SIDE (CLIPMAP_HALF * 2 + 1)       // vertices per level side
+#define CLIPMAP_TEXTURE 256                       // texels per layer side, at least CLIPMAP_SIDE
+#define CLIPMAP_HOLE_VARIANTS 4                   // inner level offset by 0 or 1 cell on each axis
+#define MIN_CLIPMAP_LEVELS 1
+#define MAX_CLIPMAP_LEVELS 12
+#define DEFAULT_CLIPMAP_LEVELS 8
+
+struct _clipmap_level_t {
+    int origin_x, origin_z;  // lattice coordinates of vertex (0, 0), in units of the level spacing
+    int valid;               // texture layer holds the heights around origin
+};
+
+typedef struct _clipmap_level_t clipmap_level_t;
+
+struct _clipmap_t {
+    int levels;
+    clipmap_level_t level[MAX_CLIPMAP_LEVELS];
+
+    float *samples;  // CPU staging for one update, CLIPMAP_SIDE^2 heights
+
+    // Index ranges in ebo: the full grid, then one ring per hole variant
+    int full_count, ring_count;
+
+    // Totals since init
+    long texels_updated;
+    double update_time;
+
+    GLuint vao, ebo, texture;
+};
+
+typedef struct _clipmap_t clipmap_t;
+
+void init_clipmap(clipmap_t *clipmap, int levels);
+void free_clipmap(clipmap_t *clipmap);
+
+void update_clipmap(clipmap_t *clipmap, vec3 pos);
+void draw_clipmap(clipmap_t *clipmap, GLuint shader);
+
+float clipmap_view_distance(clipmap_t *clipmap);
+
+#endif  // CLIPMAP_H
@@ -0,0 +1,215 @@
+#include "fractal.h"
+
+#include <math.h>
+#include <string.h>
+
+#include "noise.h"
+
+// Samples per octave buffer: octave planes are filled a tile at a time
+#define FRACTAL_TILE 2048
+
+typedef void (*combine_t)(float *out, float *const *octaves, const float *amplitudes, int octaves_count, int count);
+
+fractal_t fractal_params = {FRACTAL_FBM, 1, 2.0f, 0.5f};
+
+// Per octave frequency, normalized amplitude and offset, precomputed by set_fractal
+float octave_frequency[MAX_OCTAVES] = {1.0f}, octave_amplitude[MAX_OCTAVES] = {1.0f};
+float octave_offset_x[MAX_OCTAVES], octave_offset_z[MAX_OCTAVES];
+
+const char *fractal_names[] = {"fbm", "ridged", "billow"};
+
+// Octave shaping, each maps [-1, 1] to [-1, 1]
+#define SHAPE_FBM(n) (n)
+#define SHAPE_RIDGED(n) (1.0f - 2.0f * fabsf(n))
+#define SHAPE_BILLOW(n) (2.0f * fabsf(n) - 1.0f)
+
+#define SHAPE_OCTAVE(type, n) \
+    ((type) == FRACTAL_RIDGED ? SHAPE_RIDGED(n) : (type) == FRACTAL_BILLOW ? SHAPE_BILLOW(n) : SHAPE_FBM(n))
+
+// Unrolled octave sums: TERMS_N(T) expands to T(0) + ... + T(N - 1)
+#define TERMS_1(T) T(0)
+#define TERMS_2(T) TERMS_1(T) + T(1)
+#define TERMS_3(T) TERMS_2(T) + T(2)
+#define TERMS_4(T) TERMS_3(T) + T(3)
+#define TERMS_5(T) TERMS_4(T) + T(4)
+#define TERMS_6(T) TERMS_5(T) + T(5)
+#define TERMS_7(T) TERMS_6(T) + T(6)
+#define TERMS_8(T) TERMS_7(T) + T(7)
+
+#define TERM_FBM(k) amplitudes[k] * SHAPE_FBM(octaves[k][i])
+#define TERM_RIDGED(k) amplitudes[k] * SHAPE_RIDGED(octaves[k][i])
+#define TERM_BILLOW(k) amplitudes[k] * SHAPE_BILLOW(octaves[k][i])
+
+// One kernel per type and octave count: a straight-line sum per sample
+#define COMBINE_KERNEL(type, TERM, n)                                                                        \
+    void combine_##type##_##n(float *out, float *const *octaves, const float *amplitudes, int octaves_count, \
+                              int count) {                                                                   \
+        for (int i = 0; i < count; i++)                                                                      \
+            out[i] = TERMS_##n(TERM);                                                                        \
+    }
+
+#define COMBINE_KERNELS(type, TERM)   \
+    COMBINE_KERNEL(type, TERM, 1)     \
+    COMBINE_KERNEL(type, TERM, 2)     \
+    COMBINE_KERNEL(type, TERM, 3)     \
+    COMBINE_KERNEL(type, TERM, 4)     \
+    COMBINE_KERNEL(type, TERM, 5)     \
+    COMBINE_KERNEL(type, TERM, 6)     \
+    COMBINE_KERNEL(type, TERM, 7)     \
+    COMBINE_KERNEL(type, TERM, 8)
+
+COMBINE_KERNELS(fbm, TERM_FBM)
+COMBINE_KERNELS(ridged, TERM_RIDGED)
+COMBINE_KERNELS(billow, TERM_BILLOW)
+
+#define COMBINE_TABLE(type)                                                                              \
+    {                                                                                                    \
+        combine_##type##_1, combine_##type##_2, combine_##type##_3, combine_##type##_4, combine_##type##_5, \
+            combine_##type##_6, combine_##type##_7, combine_##type##_8                                   \
+    }
+
+combine_t combine_kernels[][UNROLLED_OCTAVES] = {
+    COMBINE_TABLE(fbm),
+    COMBINE_TABLE(ridged),
+    COMBINE_TABLE(billow),
+};
+
+void combine_generic(float *out, float *const *octaves, const float *amplitudes, int octaves_count, int count) {
+    // Octave counts past UNROLLED_OCTAVES: one pass per octave
+    int type = fractal_params.type;
+
+    for (int i = 0; i < count; i++)
+        out[i] = 0.0f;
+
+    for (int k = 0; k < octaves_count; k++)
+        for (int i = 0; i < count; i++)
+            out[i] += amplitudes[k] * SHAPE_OCTAVE(type, octaves[k][i]);
+}
+
+void set_fractal(const fractal_t *fractal) {
+    fractal_params = *fractal;
+
+    if (fractal_params.type < FRACTAL_FBM || fractal_params.type > FRACTAL_BILLOW)
+        fractal_params.type = FRACTAL_FBM;
+
+    if (fractal_params.octaves < 1)
+        fractal_params.octaves = 1;
+    if (fractal_params.octaves > MAX_OCTAVES)
+        fractal_params.octaves = MAX_OCTAVES;
+
+    float frequency = 1.0f, amplitude = 1.0f, total = 0.0f;
+
+    for (int k = 0; k < fractal_params.octaves; k++) {
+        octave_frequency[k] = frequency;
+        octave_amplitude[k] = amplitude;
+        total += amplitude;
+
+        // Shift each octave off the origin so their lattices do not line up
+        octave_offset_x[k] = k * 101.3f;
+        octave_offset_z[k] = k * -67.9f;
+
+        frequency *= fractal_params.lacunarity;
+        amplitude *= fractal_params.gain;
+    }
+
+    // Keep the sum in [-1, 1]
+    for (int k = 0; k < fractal_params.octaves; k++)
+        octave_amplitude[k] /= total;
+}
+
+void get_fractal(fractal_t *fractal) {
+    *fractal = fractal_params;
+}
+
+int parse_fractal_type(const char *name) {
+    for (int i = 0; i < (int)(sizeof(fractal_names) / sizeof(fractal_names[0])); i++)
+        if (!strcmp(name, fractal_names[i]))
+            return i;
+
+    return -1;
+}
+
+const char *fractal_name() {
+    return fractal_names[fractal_params.type];
+}
+
+float fractal(float x, float z) {
+    float sum = 0.0f;
+
+    for (int k = 0; k < fractal_params.octaves; k++) {
+        float n = noise(x * octave_frequency[k] + octave_offset_x[k], z * octave_frequency[k] + octave_offset_z[k]);
+        sum += octave_amplitude[k] * SHAPE_OCTAVE(fractal_params.type, n);
+    }
+
+    return sum;
+}
+
+int fractal_octaves_below(float frequency) {
+    int octaves = 1;
+    while (octaves < fractal_params.octaves && octave_frequency[octaves] / GRID_SIZE <= frequency)
+        octaves++;
+
+    return octaves;
+}
+
+void fractal_grid(float *out, float x, float z, float x_step, float z_step, int width, int height) {
+    fractal_grid_octaves(out, x, z, x_step, z_step, width, height, fractal_params.octaves);
+}
+
+void fractal_grid_octaves(float *out, float x, float z, float x_step, float z_step, int width, int height,
+                          int octaves) {
+    octaves = octaves < 1 ? 1 : octaves > fractal_params.octaves ? fractal_params.octaves : octaves;
+
+    combine_t combine = octaves <= UNROLLED_OCTAVES ? combine_kernels[fractal_params.type][octaves - 1]
+                                                    : combine_generic;
+
+    // One plain pass needs no octave buffers at all
+    if (fractal_params.octaves == 1 && fractal_params.type == FRACTAL_FBM) {
+        noise_grid(out, x, z, x_step, z_step, width, height);
+        return;
+    }
+
+    float planes[MAX_OCTAVES][FRACTAL_TILE];
+    float *octave_planes[MAX_OCTAVES];
+
+    for (int k = 0; k < octaves; k++)
+        octave_planes[k] = planes[k];
+
+    // Tiles of tile_width x tile_height samples, one noise_grid per octave each
+    int tile_width = width < FRACTAL_TILE ? width : FRACTAL_TILE;
+    int tile_height = FRACTAL_TILE / tile_width;
+
+    for (int j = 0; j < height; j += tile_height)
+        for (int i = 0; i < width; i += tile_width) {
+            int w = width - i < tile_width ? width - i : tile_width;
+            int h = height - j < tile_height ? height - j : tile_height;
+
+            for (int k = 0; k < octaves; k++) {
+                float f = octave_frequency[k];
+                float octave_x = (x + i * x_step) * f + octave_offset_x[k];
+                float octave_z = (z + j * z_step) * f + octave_offset_z[k];
+
+                // noise_grid hashes every lattice corner under the tile, more than
+                // one per sample once octaves outgrow the sample spacing
+                if (fabsf(x_step * z_step) * f * f > GRID_SIZE * GRID_SIZE / 4) {
+                    for (int r = 0; r < h; r++)
+                        noise_batch(planes[k] + r * w, octave_x, octave_z + r * z_step * f, x_step * f, w);
+                } else {
+                    noise_grid(planes[k], octave_x, octave_z, x_step * f, z_step * f, w, h);
+                }
+            }
+
+            // Planes are w wide, out is width wide
+            if (w == width) {
+                combine(out + j * width, octave_planes, octave_amplitude, octaves, w * h);
+            } else {
+                for (int r = 0; r < h; r++) {
+                    float *rows[MAX_OCTAVES];
+                    for (int k = 0; k < octaves; k++)
+                        rows[k] = planes[k] + r * w;
+
+                    combine(out + (j + r) * width + i, rows, octave_amplitude, octaves, w);
+                }
+            }
+        }
+}
@@ -0,0 +1,46 @@
+#ifndef FRACTAL_H
+#define FRACTAL_H
+
+// Octaves of noise() summed into fractal terrain, part of libterrain. One fBm
+// octave is plain noise(), the default.
+
+#define MAX_OCTAVES 16
+#define UNROLLED_OCTAVES 8  // octave counts with a specialized kernel
+
+enum {
+    FRACTAL_FBM,     // sum of octaves
+    FRACTAL_RIDGED,  // sharp crests where octaves cross zero
+    FRACTAL_BILLOW,  // rounded hills, creased valleys
+};
+
+struct _fractal_t {
+    int type, octaves;
+    float lacunarity;  // frequency multiplier per octave
+    float gain;        // amplitude multiplier per octave
+};
+
+typedef struct _fractal_t fractal_t;
+
+// Not thread safe: set before any chunk generation starts
+void set_fractal(const fractal_t *fractal);
+void get_fractal(fractal_t *fractal);
+
+int parse_fractal_type(const char *name);
+const char *fractal_name();
+
+// In [-1, 1] like noise()
+float fractal(float x, float z);
+
+// As noise_grid, one noise_grid pass per octave
+void fractal_grid(float *out, float x, float z, float x_step, float z_step, int width, int height);
+
+// The same summing only the first octaves, the rest left out rather than
+// renormalized, so the result stays the smooth part of the full sum
+void fractal_grid_octaves(float *out, float x, float z, float x_step, float z_step, int width, int height,
+                          int octaves);
+
+// How many octaves reach no higher than frequency, in cycles per unit, and
+// at least one: below Nyquist for samples 1 / (2 * frequency) apart
+int fractal_octaves_below(float frequency);
+
+#endif  // FRACTAL_H
@@ -0,0 +1,34 @@
+#include "frustum.h"
+
+void extract_frustum(frustum_t frustum, mat4x4 view, mat4x4 projection) {
+    // Gribb & Hartmann: each plane is the w row plus or minus an x/y/z row of the clip matrix
+    mat4x4 clip;
+    mat4x4_mul(clip, projection, view);
+
+    vec4 w;
+    mat4x4_row(w, clip, 3);
+
+    for (int i = 0; i < 3; i++) {
+        vec4 row;
+        mat4x4_row(row, clip, i);
+
+        vec4_add(frustum[i * 2 + 0], w, row);
+        vec4_sub(frustum[i * 2 + 1], w, row);
+    }
+}
+
+int aabb_in_frustum(frustum_t frustum, vec3 min, vec3 max) {
+    for (int i = 0; i < 6; i++) {
+        float *plane = frustum[i];
+
+        // Only the corner furthest along the plane normal needs testing
+        vec4 corner;
+        vec4_set(corner, plane[0] > 0 ? max[0] : min[0], plane[1] > 0 ? max[1] : min[1],
+                 plane[2] > 0 ? max[2] : min[2], 1.0f);
+
+        if (vec4_dot(plane, corner) < 0)
+            return 0;
+    }
+
+    return 1;
+}
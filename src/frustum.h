@@ -0,0 +1,12 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include "linmath.h"
+
+// Left, right, bottom, top, near and far planes as (normal, distance)
+typedef vec4 frustum_t[6];
+
+void extract_frustum(frustum_t frustum, mat4x4 view, mat4x4 projection);
+int aabb_in_frustum(frustum_t frustum, vec3 min, vec3 max);
+
+#endif  // FRUSTUM_H
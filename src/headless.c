@@ -0,0 +1,82 @@
+#include "headless.h"
+
+#ifdef TERRAIN_EGL
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <stdio.h>
+
+#include "glfw.h"
+
+EGLDisplay headless_display = EGL_NO_DISPLAY;
+EGLContext headless_context = EGL_NO_CONTEXT;
+GLuint headless_framebuffer, headless_renderbuffers[2];
+
+int init_headless(int width, int height) {
+    PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display =
+        (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+
+    if (!get_platform_display) {
+        fprintf(stderr, "Error: EGL_EXT_platform_base is not supported\n");
+        return 0;
+    }
+
+    headless_display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+    if (headless_display == EGL_NO_DISPLAY || !eglInitialize(headless_display, NULL, NULL)) {
+        fprintf(stderr, "Error: unable to open a surfaceless EGL display\n");
+        return 0;
+    }
+
+    eglBindAPI(EGL_OPENGL_API);
+
+    const EGLint attributes[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 3,
+        EGL_CONTEXT_MINOR_VERSION, 3,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE,
+    };
+
+    headless_context = eglCreateContext(headless_display, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, attributes);
+    if (headless_context == EGL_NO_CONTEXT ||
+        !eglMakeCurrent(headless_display, EGL_NO_SURFACE, EGL_NO_SURFACE, headless_context)) {
+        fprintf(stderr, "Error: unable to create a GL 3.3 core context (0x%x)\n", eglGetError());
+        return 0;
+    }
+
+    // No default framebuffer without a surface, so render into our own
+    glGenFramebuffers(1, &headless_framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, headless_framebuffer);
+
+    glGenRenderbuffers(2, headless_renderbuffers);
+
+    glBindRenderbuffer(GL_RENDERBUFFER, headless_renderbuffers[0]);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, headless_renderbuffers[0]);
+
+    glBindRenderbuffer(GL_RENDERBUFFER, headless_renderbuffers[1]);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, headless_renderbuffers[1]);
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        fprintf(stderr, "Error: offscreen framebuffer is incomplete\n");
+        return 0;
+    }
+
+    glViewport(0, 0, width, height);
+    return 1;
+}
+
+void *headless_proc_address(const char *name) {
+    return (void *)eglGetProcAddress(name);
+}
+
+void free_headless() {
+    glDeleteFramebuffers(1, &headless_framebuffer);
+    glDeleteRenderbuffers(2, headless_renderbuffers);
+
+    eglMakeCurrent(headless_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    eglDestroyContext(headless_display, headless_context);
+    eglTerminate(headless_display);
+}
+
+#endif  // TERRAIN_EGL
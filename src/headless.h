@@ -0,0 +1,12 @@
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+// Window-less GL 3.3 core context rendering into an offscreen framebuffer,
+// available when built with TERRAIN_EGL (EGL surfaceless, e.g. Mesa llvmpipe)
+
+int init_headless(int width, int height);
+void free_headless();
+
+void *headless_proc_address(const char *name);
+
+#endif  // HEADLESS_H
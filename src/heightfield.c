@@ -0,0 +1,178 @@
+#include "heightfield.h"
+
+#include <string.h>
+
+void stitch_vertex(int vertex[2], int cells, int coarser);
+int edge_vertex(int edge, int i, int cells);
+int collapsed(int v[3][2]);
+
+void terrain_generate_heights(int chunk_x, int chunk_z, float *out) {
+    terrain_generate_rows(chunk_x, chunk_z, 0, CHUNK_SIZE_1, out);
+}
+
+void terrain_generate_rows(int chunk_x, int chunk_z, int row, int count, float *out) {
+    terrain_generate_level_rows(chunk_x, chunk_z, 0, row, count, out);
+}
+
+void terrain_generate_level_rows(int chunk_x, int chunk_z, int level, int row, int count, float *out) {
+    int side = CHUNK_MIP_SIDE(level);
+    float step = (float)(1 << level);
+    float min_x = chunk_x * CHUNK_SIZE;
+    float min_z = chunk_z * CHUNK_SIZE - row * step;
+
+    int octaves = chunk_level_octaves(level);
+    fractal_grid_octaves(out, min_x, min_z, step, -step, side, count, octaves);
+
+    // Edges keep every octave, so they still match neighbours sampled at
+    // other levels, and the edges of the pyramid of a full resolution chunk
+    fractal_t fractal;
+    get_fractal(&fractal);
+
+    if (octaves < fractal.octaves) {
+        float column[CHUNK_SIZE_1];
+
+        for (int edge = 0; edge < 2; edge++) {
+            fractal_grid(column, min_x + edge * CHUNK_SIZE, min_z, step, -step, 1, count);
+
+            for (int j = 0; j < count; j++)
+                out[edge * (side - 1) + j * side] = column[j];
+        }
+
+        if (row == 0)
+            fractal_grid(out, min_x, min_z, step, -step, side, 1);
+        if (row + count == side)
+            fractal_grid(out + (count - 1) * side, min_x, min_z - (count - 1) * step, step, -step, side, 1);
+    }
+
+    for (int i = 0; i < side * count; i++)
+        out[i] = (out[i] + 1.0f) / 2.0f;
+}
+
+int chunk_level_octaves(int level) {
+    // Level 0 is the reference and keeps every octave
+    if (level == 0)
+        return MAX_OCTAVES;
+
+    return fractal_octaves_below(1.0f / (2 << level));
+}
+
+void terrain_generate_grid(float x, float z, float step, int width, int height, float *out) {
+    fractal_grid(out, x, z, step, step, width, height);
+
+    for (int i = 0; i < width * height; i++)
+        out[i] = (out[i] + 1.0f) / 2.0f;
+}
+
+void terrain_height_bounds(const float *heights, int count, float *min, float *max) {
+    *min = 1.0f;
+    *max = 0.0f;
+
+    for (int i = 0; i < count; i++) {
+        if (heights[i] < *min) *min = heights[i];
+        if (heights[i] > *max) *max = heights[i];
+    }
+}
+
+// The closed forms of CHUNK_MIP_CELLS and CHUNK_MIP_SAMPLES need the pyramid to end at one cell
+_Static_assert(CHUNK_SIZE >> (CHUNK_MIPS - 1) == 1, "CHUNK_MIPS must reach a single cell");
+
+int chunk_mip_offset(int level) {
+    int offset = 0;
+    for (int l = 0; l < level; l++)
+        offset += CHUNK_MIP_SIDE(l) * CHUNK_MIP_SIDE(l);
+
+    return offset;
+}
+
+int chunk_bounds_offset(int level, int max) {
+    int offset = chunk_mip_offset(CHUNK_MIPS) + (max ? CHUNK_MIP_CELLS : 0);
+    for (int l = 1; l < level; l++)
+        offset += (CHUNK_SIZE >> l) * (CHUNK_SIZE >> l);
+
+    return offset;
+}
+
+void terrain_generate_indices(u_int16_t *indices) {
+    terrain_generate_lod_indices(indices, 0, 0);
+}
+
+int terrain_generate_lod_indices(u_int16_t *indices, int lod, int coarser) {
+    int cells = CHUNK_SIZE >> lod, side = cells + 1;
+    int offset = chunk_mip_offset(lod);
+    int count = 0;
+
+    for (int x = 0; x < cells; x++)
+        for (int z = 0; z < cells; z++) {
+            int quad[6][2] = {
+                {x + 0, z + 0}, {x + 1, z + 0}, {x + 0, z + 1}, {x + 1, z + 1}, {x + 0, z + 1}, {x + 1, z + 0},
+            };
+
+            for (int k = 0; k < 6; k++)
+                stitch_vertex(quad[k], cells, coarser);
+
+            for (int t = 0; t < 6; t += 3) {
+                if (collapsed(quad + t))
+                    continue;
+
+                for (int k = t; k < t + 3; k++)
+                    indices[count++] = offset + quad[k][0] + quad[k][1] * side;
+            }
+        }
+
+    return count;
+}
+
+int terrain_generate_skirt_indices(u_int16_t *indices, int lod) {
+    int cells = CHUNK_SIZE >> lod;
+    int offset = chunk_mip_offset(lod), skirts = chunk_mip_offset(CHUNK_LODS);
+    int count = 0;
+
+    for (int edge = 0; edge < 4; edge++)
+        for (int i = 0; i < cells; i++) {
+            u_int16_t top[2] = {offset + edge_vertex(edge, i, cells), offset + edge_vertex(edge, i + 1, cells)};
+            u_int16_t bottom[2] = {skirts + edge * CHUNK_SIZE_1 + (i << lod),
+                                   skirts + edge * CHUNK_SIZE_1 + ((i + 1) << lod)};
+
+            // Both windings: a crack can be seen from either chunk
+            u_int16_t quad[12] = {
+                top[0], bottom[0], top[1], top[1], bottom[0], bottom[1],
+                top[0], top[1], bottom[0], top[1], bottom[1], bottom[0],
+            };
+
+            memcpy(indices + count, quad, sizeof(quad));
+            count += 12;
+        }
+
+    return count;
+}
+
+void stitch_vertex(int vertex[2], int cells, int coarser) {
+    // The chunk's corners are on both levels' grids, so they never move
+    int x = vertex[0], z = vertex[1];
+
+    if ((coarser & CHUNK_EDGE_LEFT && x == 0) || (coarser & CHUNK_EDGE_RIGHT && x == cells))
+        vertex[1] -= z % 2;
+
+    if ((coarser & CHUNK_EDGE_TOP && z == 0) || (coarser & CHUNK_EDGE_BOTTOM && z == cells))
+        vertex[0] -= x % 2;
+}
+
+int edge_vertex(int edge, int i, int cells) {
+    int side = cells + 1;
+
+    switch (1 << edge) {
+    case CHUNK_EDGE_LEFT:
+        return i * side;
+    case CHUNK_EDGE_RIGHT:
+        return cells + i * side;
+    case CHUNK_EDGE_TOP:
+        return i;
+    default:
+        return i + cells * side;
+    }
+}
+
+int collapsed(int v[3][2]) {
+    // Two corners snapped together, or all three onto a line where two stitched edges meet
+    return (v[1][0] - v[0][0]) * (v[2][1] - v[0][1]) == (v[2][0] - v[0][0]) * (v[1][1] - v[0][1]);
+}
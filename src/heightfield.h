@@ -0,0 +1,85 @@
+#ifndef HEIGHTFIELD_H
+#define HEIGHTFIELD_H
+
+// GL-free chunk generation, part of libterrain. Call init_noise() once, and
+// optionally set_fractal(), before generating.
+
+#include <sys/types.h>
+
+#include "fractal.h"
+#include "noise.h"
+
+#define CHUNK_SIZE 128
+#define CHUNK_SIZE_1 (CHUNK_SIZE + 1)
+#define CHUNK_SIZE_SQ (CHUNK_SIZE * CHUNK_SIZE)
+#define CHUNK_SIZE_1_SQ (CHUNK_SIZE_1 * CHUNK_SIZE_1)
+#define CHUNK_INDICES (CHUNK_SIZE_SQ * 6)
+
+// A chunk's samples are its heights followed by a mip pyramid: averaged
+// heights for levels 1 to CHUNK_MIPS - 1, with CHUNK_MIP_SIDE(level) samples
+// a side, then the minimum and maximum height of each of the CHUNK_SIZE >>
+// level cells a side of those levels. Edge samples are never averaged, so
+// every level agrees with its neighbours and with the other levels there.
+#define CHUNK_MIPS 8  // 129, 65, 33, 17, 9, 5, 3 and 2 samples a side
+#define CHUNK_MIP_SIDE(level) ((CHUNK_SIZE >> (level)) + 1)
+// The last level is a single cell, so the cells of levels 1 to CHUNK_MIPS - 1
+// sum to (CHUNK_SIZE_SQ - 1) / 3, and their samples add a row and a column each
+#define CHUNK_MIP_CELLS ((CHUNK_SIZE_SQ - 1) / 3)
+#define CHUNK_MIP_SAMPLES (CHUNK_MIP_CELLS + 2 * (CHUNK_SIZE - 1) + CHUNK_MIPS - 1)
+#define CHUNK_DATA_SAMPLES (CHUNK_SIZE_1_SQ + CHUNK_MIP_SAMPLES + CHUNK_MIP_CELLS * 2)
+
+// Coarser levels of a chunk are drawn from its pyramid, whose first level a
+// far chunk may be sampled at directly
+#define CHUNK_LODS 5
+#define CHUNK_STITCH_VARIANTS 16  // one per combination of CHUNK_EDGE_* bits
+
+// Skirt vertices follow the levels drawn, CHUNK_SIZE_1 per edge in CHUNK_EDGE_* bit order
+#define CHUNK_SKIRT_VERTICES (CHUNK_SIZE_1 * 4)
+#define CHUNK_SKIRT_INDICES (CHUNK_SIZE * 4 * 12)
+
+enum {
+    CHUNK_EDGE_LEFT = 1,    // x = 0
+    CHUNK_EDGE_RIGHT = 2,   // x = CHUNK_SIZE
+    CHUNK_EDGE_TOP = 4,     // z = 0, the chunk_z + 1 side
+    CHUNK_EDGE_BOTTOM = 8,  // z = CHUNK_SIZE, the chunk_z - 1 side
+};
+
+// Fills out[x + z * CHUNK_SIZE_1] with the height in [0, 1] at world
+// (chunk_x * CHUNK_SIZE + x, chunk_z * CHUNK_SIZE - z)
+void terrain_generate_heights(int chunk_x, int chunk_z, float *out);
+
+// The same for rows [row, row + count) only, out points at the first of them
+void terrain_generate_rows(int chunk_x, int chunk_z, int row, int count, float *out);
+
+// The same for pyramid level level sampled directly, 1 << level apart, with
+// CHUNK_MIP_SIDE(level) samples a row. Interior samples leave out the
+// octaves above Nyquist for that spacing, edge samples keep them all.
+void terrain_generate_level_rows(int chunk_x, int chunk_z, int level, int row, int count, float *out);
+
+// Octaves a level is sampled with, MAX_OCTAVES for all of them at level 0
+int chunk_level_octaves(int level);
+void terrain_height_bounds(const float *heights, int count, float *min, float *max);
+
+// Fills out[i + j * width] with the height at world (x + i * step, z + j * step)
+void terrain_generate_grid(float x, float z, float step, int width, int height, float *out);
+
+// Where a level's averaged samples start, 0 for the heights themselves, and
+// where its minimum or maximum cells start, for levels from 1
+int chunk_mip_offset(int level);
+int chunk_bounds_offset(int level, int max);
+
+// Two triangles per quad over one chunk's CHUNK_SIZE_1_SQ vertices
+void terrain_generate_indices(u_int16_t *indices);
+
+// The same over the averaged samples of pyramid level lod. Edges in coarser
+// meet a neighbour one level coarser: every other vertex along them is
+// snapped onto the one before, and the triangles that collapse are left out.
+// Returns the index count.
+int terrain_generate_lod_indices(u_int16_t *indices, int lod, int coarser);
+
+// Two-sided strips from each edge of level lod down to the skirt vertices,
+// which start at chunk_mip_offset(CHUNK_LODS). Returns the index count, at
+// most CHUNK_SKIRT_INDICES.
+int terrain_generate_skirt_indices(u_int16_t *indices, int lod);
+
+#endif  // HEIGHTFIELD_H
@@ -0,0 +1,254 @@
+#include "jobs.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "timer.h"
+
+void *run_worker(void *arg);
+void push_queued(job_pool_t *pool, job_t *job);
+job_t *pop_queued(job_pool_t *pool);
+void sift_up(job_pool_t *pool, int i);
+void sift_down(job_pool_t *pool, int i);
+
+void init_jobs(job_pool_t *pool, int threads_count, int jobs_count, size_t buffer_size, job_func_t func) {
+    pool->func = func;
+    pool->stop = 0;
+
+    pool->queue = (job_t **)malloc(sizeof(job_t *) * jobs_count);
+    pool->done_jobs = NULL;
+    pool->queued_count = pool->running_count = pool->done_count = 0;
+
+    // Every job owns a fixed CPU buffer, so generation never allocates
+    pool->jobs = (job_t *)malloc(sizeof(job_t) * jobs_count);
+    pool->buffers = malloc(buffer_size * jobs_count);
+
+    pool->free_jobs = NULL;
+    for (int i = jobs_count - 1; i >= 0; i--) {
+        pool->jobs[i].data = (char *)pool->buffers + buffer_size * i;
+        pool->jobs[i].next = pool->free_jobs;
+        pool->free_jobs = &pool->jobs[i];
+    }
+
+    pthread_mutex_init(&pool->mutex, NULL);
+    pthread_cond_init(&pool->cond, NULL);
+
+    pool->threads_count = threads_count;
+    pool->threads = (pthread_t *)malloc(sizeof(pthread_t) * threads_count);
+
+    for (int i = 0; i < threads_count; i++)
+        if (pthread_create(&pool->threads[i], NULL, run_worker, pool) != 0) {
+            fprintf(stderr, "Error: unable to start worker thread\n");
+            exit(EXIT_FAILURE);
+        }
+}
+
+void free_jobs(job_pool_t *pool) {
+    pthread_mutex_lock(&pool->mutex);
+    pool->stop = 1;
+    pthread_cond_broadcast(&pool->cond);
+    pthread_mutex_unlock(&pool->mutex);
+
+    for (int i = 0; i < pool->threads_count; i++)
+        pthread_join(pool->threads[i], NULL);
+
+    pthread_mutex_destroy(&pool->mutex);
+    pthread_cond_destroy(&pool->cond);
+
+    free(pool->threads);
+    free(pool->jobs);
+    free(pool->buffers);
+    free(pool->queue);
+}
+
+job_t *acquire_job(job_pool_t *pool) {
+    // Only the owning thread takes and returns free jobs, no locking needed
+    job_t *job = pool->free_jobs;
+
+    if (job)
+        pool->free_jobs = job->next;
+
+    return job;
+}
+
+void submit_job(job_pool_t *pool, job_t *job) {
+    pthread_mutex_lock(&pool->mutex);
+
+    push_queued(pool, job);
+
+    pthread_cond_signal(&pool->cond);
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+job_t *collect_job(job_pool_t *pool) {
+    pthread_mutex_lock(&pool->mutex);
+
+    job_t *job = pool->done_jobs;
+    if (job) {
+        pool->done_jobs = job->next;
+        pool->done_count--;
+    }
+
+    pthread_mutex_unlock(&pool->mutex);
+    return job;
+}
+
+job_t *take_job(job_pool_t *pool) {
+    pthread_mutex_lock(&pool->mutex);
+
+    job_t *job = pop_queued(pool);
+    if (job)
+        pool->running_count++;
+
+    pthread_mutex_unlock(&pool->mutex);
+    return job;
+}
+
+void finish_job(job_pool_t *pool, job_t *job) {
+    pthread_mutex_lock(&pool->mutex);
+
+    job->next = pool->done_jobs;
+    pool->done_jobs = job;
+
+    pool->running_count--;
+    pool->done_count++;
+
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+void release_job(job_pool_t *pool, job_t *job) {
+    job->next = pool->free_jobs;
+    pool->free_jobs = job;
+}
+
+int rescore_jobs(job_pool_t *pool, job_score_t score, void *arg) {
+    int cancelled = 0;
+
+    pthread_mutex_lock(&pool->mutex);
+
+    // Compact the survivors, then rebuild the heap bottom up
+    int count = 0;
+    for (int i = 0; i < pool->queued_count; i++) {
+        job_t *job = pool->queue[i];
+        job->priority = score(job, arg);
+
+        if (job->priority < 0) {
+            release_job(pool, job);
+            cancelled++;
+        } else {
+            pool->queue[count++] = job;
+        }
+    }
+
+    pool->queued_count = count;
+    for (int i = count / 2 - 1; i >= 0; i--)
+        sift_down(pool, i);
+
+    pthread_mutex_unlock(&pool->mutex);
+    return cancelled;
+}
+
+int queued_jobs(job_pool_t *pool) {
+    pthread_mutex_lock(&pool->mutex);
+    int count = pool->queued_count;
+    pthread_mutex_unlock(&pool->mutex);
+
+    return count;
+}
+
+int in_flight_jobs(job_pool_t *pool) {
+    pthread_mutex_lock(&pool->mutex);
+    int count = pool->queued_count + pool->running_count + pool->done_count;
+    pthread_mutex_unlock(&pool->mutex);
+
+    return count;
+}
+
+void *run_worker(void *arg) {
+    job_pool_t *pool = (job_pool_t *)arg;
+
+    pthread_mutex_lock(&pool->mutex);
+
+    while (1) {
+        while (!pool->stop && !pool->queued_count)
+            pthread_cond_wait(&pool->cond, &pool->mutex);
+
+        if (pool->stop)
+            break;
+
+        job_t *job = pop_queued(pool);
+        pool->running_count++;
+
+        pthread_mutex_unlock(&pool->mutex);
+
+        double start = get_time();
+        pool->func(job);
+        job->time = get_time() - start;
+
+        pthread_mutex_lock(&pool->mutex);
+
+        job->next = pool->done_jobs;
+        pool->done_jobs = job;
+
+        pool->running_count--;
+        pool->done_count++;
+    }
+
+    pthread_mutex_unlock(&pool->mutex);
+    return NULL;
+}
+
+// The queue helpers expect the pool mutex to be held
+
+void push_queued(job_pool_t *pool, job_t *job) {
+    pool->queue[pool->queued_count] = job;
+    sift_up(pool, pool->queued_count++);
+}
+
+job_t *pop_queued(job_pool_t *pool) {
+    if (!pool->queued_count)
+        return NULL;
+
+    job_t *job = pool->queue[0];
+    pool->queue[0] = pool->queue[--pool->queued_count];
+    sift_down(pool, 0);
+
+    return job;
+}
+
+void sift_up(job_pool_t *pool, int i) {
+    job_t **queue = pool->queue;
+
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        if (queue[parent]->priority <= queue[i]->priority)
+            break;
+
+        job_t *tmp = queue[parent];
+        queue[parent] = queue[i];
+        queue[i] = tmp;
+        i = parent;
+    }
+}
+
+void sift_down(job_pool_t *pool, int i) {
+    job_t **queue = pool->queue;
+    int count = pool->queued_count;
+
+    while (1) {
+        int smallest = i, left = 2 * i + 1, right = left + 1;
+
+        if (left < count && queue[left]->priority < queue[smallest]->priority)
+            smallest = left;
+        if (right < count && queue[right]->priority < queue[smallest]->priority)
+            smallest = right;
+
+        if (smallest == i)
+            break;
+
+        job_t *tmp = queue[smallest];
+        queue[smallest] = queue[i];
+        queue[i] = tmp;
+        i = smallest;
+    }
+}
@@ -0,0 +1,71 @@
+#ifndef JOBS_H
+#define JOBS_H
+
+#include <pthread.h>
+
+struct _job_t {
+    int chunk_x, chunk_z;
+    int level;  // sampled 1 << level apart
+    int slot;
+
+    void *data;     // pooled buffer, owned by the job pool
+    void *context;  // set by the submitter for the job function
+    float min_height, max_height;
+    int loaded;    // filled from a cache rather than generated
+    int progress;  // rows done so far by an incremental job function
+
+    float priority;  // lower runs first
+    double time;     // seconds spent in the job function
+
+    struct _job_t *next;
+};
+
+typedef struct _job_t job_t;
+
+typedef void (*job_func_t)(job_t *job);
+
+// New priority for a queued job, or a negative value to cancel it
+typedef float (*job_score_t)(job_t *job, void *arg);
+
+struct _job_pool_t {
+    pthread_t *threads;
+    int threads_count;
+
+    job_t *jobs;
+    void *buffers;
+    job_func_t func;
+
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+
+    job_t *free_jobs;
+    job_t **queue;  // binary heap on priority
+    job_t *done_jobs;
+
+    int queued_count, running_count, done_count;
+    int stop;
+};
+
+typedef struct _job_pool_t job_pool_t;
+
+void init_jobs(job_pool_t *pool, int threads_count, int jobs_count, size_t buffer_size, job_func_t func);
+void free_jobs(job_pool_t *pool);
+
+job_t *acquire_job(job_pool_t *pool);
+void submit_job(job_pool_t *pool, job_t *job);
+job_t *collect_job(job_pool_t *pool);
+void release_job(job_pool_t *pool, job_t *job);
+
+// For pools without workers: the owning thread runs queued jobs itself,
+// possibly across several frames, then hands them back for collect_job
+job_t *take_job(job_pool_t *pool);
+void finish_job(job_pool_t *pool, job_t *job);
+
+// Re-scores every queued job, returning cancelled ones to the free list.
+// Main thread only, like acquire_job. Returns the number cancelled.
+int rescore_jobs(job_pool_t *pool, job_score_t score, void *arg);
+
+int queued_jobs(job_pool_t *pool);
+int in_flight_jobs(job_pool_t *pool);
+
+#endif  // JOBS_H
@@ -10,42 +10,171 @@
 #include "stb_image.h"
 
 #define ENGINE_INCLUDES
+#include "bench.h"
+#include "clipmap.h"
+#include "fractal.h"
+#include "headless.h"
+#include "noise.h"
+#include "quadtree.h"
 #include "shader.h"
 #include "terrain.h"
+#include "timer.h"
+
+enum {
+    DRAW_CHUNKS,
+    DRAW_CLIPMAP,
+    DRAW_QUADTREE,
+};
 
 GLFWwindow *window;
+bench_t bench = {.path = BENCH_NONE};
 
 float yaw = 0.0f, pitch = -M_PI_4;
 vec3 pos = {0.0f, 10.0f, 0.0f};
 vec3 dir = {0.0f, 0.0f, 0.0f};
 
-void init();
+void init(int visible);
+void init_gl();
+void init_headless_bench();
 void deinit();
+void *get_gl_proc(const char *name);
+
+int running();
+
+int main(int argc, char **argv) {
+    fractal_t fractal = {FRACTAL_FBM, 1, 2.0f, 0.5f};
+
+    terrain_options_t options;
+    default_terrain_options(&options);
+    options.get_proc = get_gl_proc;
+
+    int bench_path = BENCH_NONE, bench_frames = BENCH_FRAMES;
+    int mode = DRAW_CHUNKS, levels = 0;  // 0 for the mode's default
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--radius") && i + 1 < argc) {
+            options.radius = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--hysteresis") && i + 1 < argc) {
+            options.hysteresis = atof(argv[++i]);
+        } else if (!strcmp(argv[i], "--threads") && i + 1 < argc) {
+            options.threads = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--budget-us") && i + 1 < argc) {
+            options.budget_us = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--prefetch") && i + 1 < argc) {
+            options.prefetch_horizon = atof(argv[++i]);
+        } else if (!strcmp(argv[i], "--cache-mb") && i + 1 < argc && atoi(argv[i + 1]) >= 0) {
+            options.cache_bytes = (size_t)atoi(argv[++i]) * 1024 * 1024;
+        } else if (!strcmp(argv[i], "--tiles") && i + 1 < argc) {
+            options.tiles_dir = argv[++i];
+        } else if (!strcmp(argv[i], "--seed") && i + 1 < argc) {
+            set_noise_seed((unsigned int)strtoul(argv[++i], NULL, 10));
+        } else if (!strcmp(argv[i], "--fractal") && i + 1 < argc && parse_fractal_type(argv[i + 1]) >= 0) {
+            fractal.type = parse_fractal_type(argv[++i]);
+        } else if (!strcmp(argv[i], "--octaves") && i + 1 < argc) {
+            fractal.octaves = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--lacunarity") && i + 1 < argc) {
+            fractal.lacunarity = atof(argv[++i]);
+        } else if (!strcmp(argv[i], "--gain") && i + 1 < argc) {
+            fractal.gain = atof(argv[++i]);
+        } else if (!strcmp(argv[i], "--chunk-lod") && i + 1 < argc && parse_chunk_lod(argv[i + 1]) >= 0) {
+            options.lod = parse_chunk_lod(argv[++i]);
+        } else if (!strcmp(argv[i], "--clipmap")) {
+            mode = DRAW_CLIPMAP;
+        } else if (!strcmp(argv[i], "--quadtree")) {
+            mode = DRAW_QUADTREE;
+        } else if (!strcmp(argv[i], "--levels") && i + 1 < argc && atoi(argv[i + 1]) > 0) {
+            levels = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--bench") && i + 1 < argc && parse_bench_path(argv[i + 1]) != BENCH_NONE) {
+            bench_path = parse_bench_path(argv[++i]);
+        } else if (!strcmp(argv[i], "--frames") && i + 1 < argc && atoi(argv[i + 1]) > 0) {
+            bench_frames = atoi(argv[++i]);
+        } else {
+            fprintf(stderr, "Usage: %s [--radius %d-%d] [--hysteresis N] [--threads N] [--budget-us N] [--prefetch SECONDS]"
+                    " [--cache-mb N] [--tiles DIR] [--seed N] [--fractal fbm|ridged|billow] [--octaves N]"
+                    " [--lacunarity F] [--gain F] [--chunk-lod off|skirts|stitch] [--clipmap|--quadtree] [--levels %d-%d] [--bench line|spiral|zigzag] [--frames N]\n",
+                    argv[0], MIN_RADIUS, MAX_RADIUS, MIN_CLIPMAP_LEVELS, MAX_CLIPMAP_LEVELS);
+            return EXIT_FAILURE;
+        }
+    }
+
+    set_fractal(&fractal);
 
-int main() {
-    init();
+    if (bench_path != BENCH_NONE) {
+        init_bench(&bench, bench_path, bench_frames);
+        init_headless_bench();
+    } else {
+        init(1);
+    }
 
-    char title[16];
+    char title[128];
 
-    double time_elapsed = 0, last_second = 0;
+    double time_elapsed = get_time(), last_second = time_elapsed;
     int frames = 0;
 
-    terrain_t terrain;
-    init_terrain(&terrain);
+    // Exactly one of the chunk window, the clipmap and the quadtree is drawn
+    terrain_t terrain, *chunks = NULL;
+    clipmap_t clipmap, *rings = NULL;
+    quadtree_t quadtree, *nodes = NULL;
+    int shader;
+    float far;
+
+    if (mode == DRAW_CLIPMAP) {
+        rings = &clipmap;
+        init_clipmap(rings, levels ? levels : DEFAULT_CLIPMAP_LEVELS);
+
+        printf("Clipmap: %d levels of %dx%d vertices, %.1f MB of heights\n", rings->levels, CLIPMAP_SIDE,
+               CLIPMAP_SIDE, rings->levels * CLIPMAP_TEXTURE * CLIPMAP_TEXTURE * sizeof(float) / (1024.0 * 1024.0));
+
+        far = fmaxf(100.0f, clipmap_view_distance(rings));
+        shader = load_shader("shaders/clipmap_vertex.glsl", "shaders/fragment.glsl");
+    } else if (mode == DRAW_QUADTREE) {
+        nodes = &quadtree;
+        init_quadtree(nodes, levels ? levels : DEFAULT_QUADTREE_LEVELS, options.budget_us);
+
+        printf("Quadtree: %d levels of %dx%d cell patches, %d resident patches\n", nodes->levels, QUADTREE_PATCH,
+               QUADTREE_PATCH, nodes->slots);
+
+        far = fmaxf(100.0f, quadtree_view_distance(nodes));
+        shader = load_shader("shaders/quadtree_vertex.glsl", "shaders/fragment.glsl");
+    } else {
+        chunks = &terrain;
+        init_terrain(chunks, &options);
+
+        printf("Terrain: %dx%d chunks, %.1f MB of vertices, %d cached chunks\n", chunks->side, chunks->side,
+               terrain_vertex_bytes(chunks) / (1024.0 * 1024.0), chunks->cache.capacity);
+
+        // See to the edge of the chunk window, never less than before
+        far = fmaxf(100.0f, terrain_view_distance(chunks));
+        shader = load_shader("shaders/vertex.glsl", "shaders/fragment.glsl");
+    }
 
-    int shader = load_shader("shaders/vertex.glsl", "shaders/fragment.glsl");
     glUseProgram(shader);
 
-    while (!glfwWindowShouldClose(window)) {
-        double current_time = glfwGetTime();
+    vec3 last_pos;
+    vec3_set(last_pos, pos[0], pos[1], pos[2]);
+
+    while (running()) {
+        double current_time = get_time();
         double delta = current_time - time_elapsed;
         time_elapsed = current_time;
 
         frames++;
-        if (current_time - last_second > 1.0) {
+        if (bench.path != BENCH_NONE) {
+            // Scripted flight: the path only depends on the frame number
+            bench_camera(&bench, pos, &yaw, &pitch);
+        } else if (current_time - last_second > 1.0) {
             double fps = frames / (current_time - last_second);
 
-            sprintf(title, "FPS: %.2f", fps);
+            if (chunks)
+                sprintf(title, "FPS: %.2f | Jobs: %d queued, %d in flight | Chunks: %d drawn, %d culled", fps,
+                        queued_jobs(&chunks->jobs), in_flight_jobs(&chunks->jobs), chunks->chunks_drawn,
+                        chunks->chunks_culled);
+            else if (rings)
+                sprintf(title, "FPS: %.2f | Clipmap: %d levels, %ld texels updated", fps, rings->levels,
+                        rings->texels_updated);
+            else
+                sprintf(title, "FPS: %.2f | Nodes: %d drawn, %d culled, %d deferred", fps, nodes->nodes_drawn,
+                        nodes->nodes_culled, nodes->nodes_deferred);
             glfwSetWindowTitle(window, title);
 
             frames = 0;
@@ -54,26 +183,40 @@ int main() {
 
         // Update
 
-        vec3 tmp, ahead;
+        vec3 tmp, look, ahead, velocity;
         vec3_scale(tmp, dir, delta * 20.0f);
         vec3_add(pos, tmp, pos);
 
         float xz = cos(pitch);
-        vec3_set(ahead, xz * sin(yaw), sin(pitch), -xz * cos(yaw));
-        vec3_add(ahead, ahead, pos);
-
-        update_terrain(&terrain, pos);
+        vec3_set(look, xz * sin(yaw), sin(pitch), -xz * cos(yaw));
+        vec3_add(ahead, look, pos);
+
+        // Measured rather than taken from dir, so scripted flights count too.
+        // Those move a fixed distance a frame, so they use a fixed frame time
+        // and prefetching does not depend on how fast the machine draws.
+        float dt = bench.path != BENCH_NONE ? BENCH_FRAME_TIME : delta;
+        vec3_sub(velocity, pos, last_pos);
+        vec3_scale(velocity, velocity, dt > 0 ? 1.0f / dt : 0.0f);
+        vec3_set(last_pos, pos[0], pos[1], pos[2]);
+
+        if (chunks)
+            update_terrain(chunks, pos, velocity, look);
+        else if (rings)
+            update_clipmap(rings, pos);
+        else
+            update_quadtree(nodes, pos);
 
         // Render
 
-        int width, height;
-        glfwGetFramebufferSize(window, &width, &height);
+        int width = BENCH_WIDTH, height = BENCH_HEIGHT;
+        if (window)
+            glfwGetFramebufferSize(window, &width, &height);
 
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
         mat4x4 view, projection;
         mat4x4_look_at(view, pos, ahead, (vec3){0, 1, 0});
-        mat4x4_perspective(projection, 45.0f, (float)width / (float)height, 0.1f, 100.0f);
+        mat4x4_perspective(projection, 45.0f, (float)width / (float)height, 0.1f, far);
 
         GLint view_loc = glGetUniformLocation(shader, "view");
         glUniformMatrix4fv(view_loc, 1, GL_FALSE, (float *)view);
@@ -81,16 +224,51 @@ int main() {
         GLint projection_loc = glGetUniformLocation(shader, "projection");
         glUniformMatrix4fv(projection_loc, 1, GL_FALSE, (float *)projection);
 
-        draw_terrain(&terrain);
+        frustum_t frustum;
+        extract_frustum(frustum, view, projection);
 
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+        if (chunks)
+            draw_terrain(chunks, shader, frustum);
+        else if (rings)
+            draw_clipmap(rings, shader);
+        else
+            draw_quadtree(nodes, shader, frustum);
+
+        if (bench.path != BENCH_NONE) {
+            // Count the GPU work too, vsync is off so nothing else waits on it
+            glFinish();
+            record_frame(&bench, get_time() - current_time);
+        }
+
+        if (window) {
+            glfwSwapBuffers(window);
+            glfwPollEvents();
+        }
     }
 
+    if (bench.path != BENCH_NONE) {
+        report_bench(&bench, chunks, rings, nodes);
+        free_bench(&bench);
+    }
+
+    if (chunks)
+        free_terrain(chunks);
+    else if (rings)
+        free_clipmap(rings);
+    else
+        free_quadtree(nodes);
+
     deinit();
     return EXIT_SUCCESS;
 }
 
+int running() {
+    if (bench.path != BENCH_NONE)
+        return bench.frame < bench.frames;
+
+    return !glfwWindowShouldClose(window);
+}
+
 void error_callback(int error, const char *description) {
     fprintf(stderr, "Error: %s\n", description);
 }
@@ -159,11 +337,12 @@ void mouse_position_handler(GLFWwindow *window, double xpos, double ypos) {
     yaw = fmaxf(-M_PI_4 + 0.01f, fminf(yaw, M_PI_4 - 0.01f));
 }
 
-void init() {
+void init(int visible) {
     glfwSetErrorCallback(error_callback);
     if (!glfwInit())
         exit(EXIT_FAILURE);
 
+    glfwWindowHint(GLFW_VISIBLE, visible ? GLFW_TRUE : GLFW_FALSE);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
@@ -176,12 +355,30 @@ void init() {
     }
 
     glfwMakeContextCurrent(window);
-    glfwSwapInterval(1);
+    glfwSwapInterval(bench.path == BENCH_NONE);
+
+    if (bench.path == BENCH_NONE) {
+        glfwSetKeyCallback(window, key_callback);
+        glfwSetCursorPosCallback(window, mouse_position_handler);
+        glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+    }
+
+    init_gl();
+}
 
-    glfwSetKeyCallback(window, key_callback);
-    glfwSetCursorPosCallback(window, mouse_position_handler);
-    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+void init_headless_bench() {
+#ifdef TERRAIN_EGL
+    if (!init_headless(BENCH_WIDTH, BENCH_HEIGHT))
+        exit(EXIT_FAILURE);
 
+    init_gl();
+#else
+    // No EGL: fall back to a hidden window with vsync off
+    init(0);
+#endif
+}
+
+void init_gl() {
     glClearColor(0.2f, 0.3f, 1.0f, 1.0f);
 
     glEnable(GL_CULL_FACE);
@@ -191,7 +388,22 @@ void init() {
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 }
 
+void *get_gl_proc(const char *name) {
+#ifdef TERRAIN_EGL
+    if (!window)
+        return headless_proc_address(name);
+#endif
+    return (void *)glfwGetProcAddress(name);
+}
+
 void deinit() {
+#ifdef TERRAIN_EGL
+    if (!window) {
+        free_headless();
+        return;
+    }
+#endif
+
     glfwDestroyWindow(window);
     glfwTerminate();
 }
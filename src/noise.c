@@ -0,0 +1,335 @@
+#include "noise.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "linmath.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define NOISE_X86
+#include <immintrin.h>
+#endif
+
+typedef void (*noise_batch_t)(float *out, float x, float z, float step, int count);
+
+void noise_batch_scalar(float *out, float x, float z, float step, int count);
+int grid_block(float step, int limit, int corners);
+
+noise_batch_t noise_batch_func = noise_batch_scalar;
+const char *noise_batch_name = "scalar";
+
+#define GRADIENTS_MAX 4096
+
+// Columns noise_grid takes at a time, and lattice corners its gradient table holds
+#define GRID_BLOCK_WIDTH 256
+#define GRID_BLOCK_CORNERS 2048
+
+// Bin centres of the hashed angle; the top gradient_bits of the hash pick one
+float gradient_x[GRADIENTS_MAX], gradient_z[GRADIENTS_MAX];
+int gradient_bits = 0;
+int gradient_mode = GRADIENTS_TRIG;
+
+// Mixed into the lattice hash, 0 reproduces the original terrain
+unsigned int seed_value = 0, seed_mix = 0;
+
+float lerp(float a, float b, float t) {
+    return a + (b - a) * t;
+}
+
+float fade(float t) {
+    return t * t * t * (t * (t * 6 - 15) + 10);
+}
+
+void grad(vec2 v, int xi, int zi) {
+    // https://en.wikipedia.org/wiki/Perlin_noise
+
+    const unsigned int w = 8 * sizeof(unsigned int);
+    const unsigned int s = w / 2;  // rotation width
+
+    unsigned int a = *(unsigned int *)&xi;
+    unsigned int b = *(unsigned int *)&zi;
+
+    a *= 3284157443;
+    a ^= seed_mix;
+    b ^= a << s | a >> (w - s);
+    b *= 1911520717;
+    a ^= b << s | b >> (w - s);
+    a *= 2048419325;
+
+    if (gradient_bits) {
+        unsigned int i = a >> (w - gradient_bits);
+        vec2_set(v, gradient_x[i], gradient_z[i]);
+        return;
+    }
+
+    float r = a * (M_PI / ~(~0u >> 1));  // in [0, 2*Pi]
+    vec2_set(v, sinf(r), cosf(r));
+}
+
+int lattice(float x, float *f) {
+    // Cell index and position inside the cell along one axis
+    int d = (x < 0) ? -1 : 1;
+    int i = (int)x / GRID_SIZE;
+
+    if (d == -1) i--;
+
+    if (d == 1)
+        *f = (x - i * GRID_SIZE) / GRID_SIZE;
+    else
+        *f = 1 - ((fabs(x) + GRID_SIZE) + i * GRID_SIZE) / GRID_SIZE;
+
+    return i;
+}
+
+float noise(float x, float z) {
+    float xf, zf;
+    int xi = lattice(x, &xf);
+    int zi = lattice(z, &zf);
+
+    vec2 controls[4];
+    grad(controls[0], xi + 0, zi + 0);
+    grad(controls[1], xi + 1, zi + 0);
+    grad(controls[2], xi + 0, zi + 1);
+    grad(controls[3], xi + 1, zi + 1);
+
+    vec2 p;
+    vec2_set(p, xf, zf);
+
+    vec2 offsets[4];
+    vec2_sub(offsets[0], p, (vec2){0.0f, 0.0f});
+    vec2_sub(offsets[1], p, (vec2){1.0f, 0.0f});
+    vec2_sub(offsets[2], p, (vec2){0.0f, 1.0f});
+    vec2_sub(offsets[3], p, (vec2){1.0f, 1.0f});
+
+    float u0, v0, uv0;
+    u0 = vec2_dot(offsets[0], controls[0]);
+    v0 = vec2_dot(offsets[1], controls[1]);
+    uv0 = lerp(u0, v0, fade(xf));
+
+    float u1, v1, uv1;
+    u1 = vec2_dot(offsets[2], controls[2]);
+    v1 = vec2_dot(offsets[3], controls[3]);
+    uv1 = lerp(u1, v1, fade(xf));
+
+    return lerp(uv0, uv1, fade(zf));
+}
+
+void noise_batch_scalar(float *out, float x, float z, float step, int count) {
+    for (int i = 0; i < count; i++)
+        out[i] = noise(x + i * step, z);
+}
+
+void noise_grid(float *out, float x, float z, float x_step, float z_step, int width, int height) {
+    // Fixed stack tables rather than heap ones, this runs for every octave of
+    // every generated block: the grid goes in tiles whose lattice corners fit
+    int cells[GRID_BLOCK_WIDTH];
+    float xfs[GRID_BLOCK_WIDTH], fxs[GRID_BLOCK_WIDTH];
+    vec2 grads[GRID_BLOCK_CORNERS];
+
+    // Up to half the corners across, so a tile is at least two lattice rows deep
+    int block_width = grid_block(x_step, GRID_BLOCK_WIDTH, GRID_BLOCK_CORNERS / 2);
+
+    for (int i0 = 0; i0 < width; i0 += block_width) {
+        int w = width - i0 < block_width ? width - i0 : block_width;
+
+        // Column positions are the same for every row
+        for (int i = 0; i < w; i++) {
+            cells[i] = lattice(x + (i0 + i) * x_step, &xfs[i]);
+            fxs[i] = fade(xfs[i]);
+        }
+
+        int cell_x0 = cells[0] < cells[w - 1] ? cells[0] : cells[w - 1];
+        int cell_x1 = cells[0] < cells[w - 1] ? cells[w - 1] : cells[0];
+        int grads_w = cell_x1 - cell_x0 + 2;
+        int block_height = grid_block(z_step, height, GRID_BLOCK_CORNERS / grads_w);
+
+        for (int j0 = 0; j0 < height; j0 += block_height) {
+            int h = height - j0 < block_height ? height - j0 : block_height;
+
+            float zf;
+            int cell_z0 = lattice(z + j0 * z_step, &zf), cell_z1 = lattice(z + (j0 + h - 1) * z_step, &zf);
+
+            if (cell_z1 < cell_z0) {
+                int t = cell_z0;
+                cell_z0 = cell_z1;
+                cell_z1 = t;
+            }
+
+            // One gradient per lattice corner touched by the tile
+            int grads_h = cell_z1 - cell_z0 + 2;
+
+            for (int j = 0; j < grads_h; j++)
+                for (int i = 0; i < grads_w; i++)
+                    grad(grads[i + j * grads_w], cell_x0 + i, cell_z0 + j);
+
+            for (int j = j0; j < j0 + h; j++) {
+                int zi = lattice(z + j * z_step, &zf);
+                float fz = fade(zf);
+
+                vec2 *row = grads + (zi - cell_z0) * grads_w;
+                float *dst = out + i0 + j * width;
+
+                int i = 0;
+                while (i < w) {
+                    // Walk the run of samples that share this cell's four corners
+                    int xi = cells[i];
+                    float *g0 = row[xi - cell_x0], *g1 = row[xi - cell_x0 + 1];
+                    float *g2 = row[xi - cell_x0 + grads_w], *g3 = row[xi - cell_x0 + grads_w + 1];
+
+                    float z0 = zf * g0[1], z1 = zf * g1[1];
+                    float z2 = (zf - 1.0f) * g2[1], z3 = (zf - 1.0f) * g3[1];
+
+                    for (; i < w && cells[i] == xi; i++) {
+                        float xf = xfs[i];
+
+                        float uv0 = lerp(xf * g0[0] + z0, (xf - 1.0f) * g1[0] + z1, fxs[i]);
+                        float uv1 = lerp(xf * g2[0] + z2, (xf - 1.0f) * g3[0] + z3, fxs[i]);
+
+                        dst[i] = lerp(uv0, uv1, fz);
+                    }
+                }
+            }
+        }
+    }
+}
+
+int grid_block(float step, int limit, int corners) {
+    // Samples step apart whose cells span at most corners lattice corners: n
+    // samples touch at most (n - 1) * step / GRID_SIZE + 2 cells, one more
+    // where lattice() puts a negative multiple of GRID_SIZE in the cell below,
+    // and one more for rounding in the sample positions
+    float cells = (corners - 5) * (float)GRID_SIZE / fabsf(step) + 1;
+    int samples = cells < limit ? (int)cells : limit;
+
+    return samples > 1 ? samples : 1;
+}
+
+#ifdef NOISE_X86
+
+// 8-wide AVX2 kernel
+#define NOISE_KERNEL noise_batch_avx2
+#define NOISE_FADE noise_fade_avx2
+#define NOISE_GRAD noise_grad_avx2
+#define NOISE_TARGET __attribute__((target("avx2")))
+#define LANES 8
+#define vf __m256
+#define vi __m256i
+#define vf_set1 _mm256_set1_ps
+#define vi_set1 _mm256_set1_epi32
+#define vf_lanes() _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7)
+#define vf_add _mm256_add_ps
+#define vf_sub _mm256_sub_ps
+#define vf_mul _mm256_mul_ps
+#define vf_round(a) _mm256_round_ps(a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC)
+#define vf_lt(a, b) _mm256_castps_si256(_mm256_cmp_ps(a, b, _CMP_LT_OQ))
+#define vf_store _mm256_storeu_ps
+#define vi_add _mm256_add_epi32
+#define vi_sub _mm256_sub_epi32
+#define vi_mul _mm256_mullo_epi32
+#define vi_and _mm256_and_si256
+#define vi_or _mm256_or_si256
+#define vi_xor _mm256_xor_si256
+#define vi_sra _mm256_srai_epi32
+#define vi_sll _mm256_slli_epi32
+#define vi_srl _mm256_srli_epi32
+#define vi_eq _mm256_cmpeq_epi32
+#define vi_select(a, b, mask) _mm256_blendv_epi8(a, b, mask)
+#define vf_to_vi _mm256_cvttps_epi32
+#define vi_to_vf _mm256_cvtepi32_ps
+#define vf_bits _mm256_castps_si256
+#define vi_bits _mm256_castsi256_ps
+#define vf_gather(table, i) _mm256_i32gather_ps(table, i, 4)
+#include "noise_kernel.h"
+
+// 4-wide SSE4.1 kernel
+#define NOISE_KERNEL noise_batch_sse4
+#define NOISE_FADE noise_fade_sse4
+#define NOISE_GRAD noise_grad_sse4
+#define NOISE_TARGET __attribute__((target("sse4.1")))
+#define LANES 4
+#define vf __m128
+#define vi __m128i
+#define vf_set1 _mm_set1_ps
+#define vi_set1 _mm_set1_epi32
+#define vf_lanes() _mm_setr_ps(0, 1, 2, 3)
+#define vf_add _mm_add_ps
+#define vf_sub _mm_sub_ps
+#define vf_mul _mm_mul_ps
+#define vf_round(a) _mm_round_ps(a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC)
+#define vf_lt(a, b) _mm_castps_si128(_mm_cmplt_ps(a, b))
+#define vf_store _mm_storeu_ps
+#define vi_add _mm_add_epi32
+#define vi_sub _mm_sub_epi32
+#define vi_mul _mm_mullo_epi32
+#define vi_and _mm_and_si128
+#define vi_or _mm_or_si128
+#define vi_xor _mm_xor_si128
+#define vi_sra _mm_srai_epi32
+#define vi_sll _mm_slli_epi32
+#define vi_srl _mm_srli_epi32
+#define vi_eq _mm_cmpeq_epi32
+#define vi_select(a, b, mask) _mm_blendv_epi8(a, b, mask)
+#define vf_to_vi _mm_cvttps_epi32
+#define vi_to_vf _mm_cvtepi32_ps
+#define vf_bits _mm_castps_si128
+#define vi_bits _mm_castsi128_ps
+#define vf_gather(table, i) \
+    _mm_setr_ps(table[_mm_extract_epi32(i, 0)], table[_mm_extract_epi32(i, 1)], table[_mm_extract_epi32(i, 2)], \
+                table[_mm_extract_epi32(i, 3)])
+#include "noise_kernel.h"
+
+#endif  // NOISE_X86
+
+void init_noise() {
+#ifdef NOISE_X86
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("avx2")) {
+        noise_batch_func = noise_batch_avx2;
+        noise_batch_name = "avx2";
+    } else if (__builtin_cpu_supports("sse4.1")) {
+        noise_batch_func = noise_batch_sse4;
+        noise_batch_name = "sse4.1";
+    }
+#endif
+}
+
+const char *noise_kernel() {
+    return noise_batch_name;
+}
+
+void set_noise_gradients(int mode) {
+    // Not thread safe: select the mode before any chunk generation starts
+    gradient_mode = mode;
+    gradient_bits = (mode == GRADIENTS_TABLE_256) ? 8 : (mode == GRADIENTS_TABLE_4096) ? 12 : 0;
+
+    int count = 1 << gradient_bits;
+    for (int i = 0; gradient_bits && i < count; i++) {
+        double r = (i + 0.5) * (2 * M_PI / count);
+        gradient_x[i] = sin(r);
+        gradient_z[i] = cos(r);
+    }
+}
+
+void set_noise_seed(unsigned int value) {
+    // Not thread safe, like set_noise_gradients
+    seed_value = value;
+    seed_mix = value * 2654435769u;
+}
+
+unsigned int noise_seed() {
+    return seed_value;
+}
+
+const char *noise_gradients() {
+    switch (gradient_mode) {
+        case GRADIENTS_TABLE_256: return "table-256";
+        case GRADIENTS_TABLE_4096: return "table-4096";
+        default: return "trig";
+    }
+}
+
+void noise_batch(float *out, float x, float z, float step, int count) {
+    noise_batch_func(out, x, z, step, count);
+}
@@ -0,0 +1,35 @@
+#ifndef NOISE_H
+#define NOISE_H
+
+#define GRID_SHIFT 4
+#define GRID_SIZE (1 << GRID_SHIFT)
+
+enum {
+    GRADIENTS_TRIG,        // sinf/cosf of the hashed angle, the reference
+    GRADIENTS_TABLE_256,   // 256 precomputed unit vectors
+    GRADIENTS_TABLE_4096,  // 4096 precomputed unit vectors
+};
+
+void init_noise();
+const char *noise_kernel();
+
+void set_noise_gradients(int mode);
+const char *noise_gradients();
+
+void set_noise_seed(unsigned int seed);
+unsigned int noise_seed();
+
+float noise(float x, float z);
+
+// Building blocks of noise(), exposed for the benchmarks
+float fade(float t);
+void grad(float v[2], int xi, int zi);
+
+// Evaluates noise(x + i * step, z) for i in [0, count) into out
+void noise_batch(float *out, float x, float z, float step, int count);
+
+// Evaluates noise(x + i * x_step, z + j * z_step) into out[i + j * width],
+// hashing each lattice corner once instead of once per sample
+void noise_grid(float *out, float x, float z, float x_step, float z_step, int width, int height);
+
+#endif  // NOISE_H
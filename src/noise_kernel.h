@@ -0,0 +1,133 @@
+// Vectorised noise_batch kernel, included once per instruction set by noise.c
+// with NOISE_KERNEL, NOISE_FADE, NOISE_GRAD, NOISE_TARGET, LANES and the
+// vf_* / vi_* operations defined. Matches noise() to within float rounding of
+// the gradient angle.
+
+NOISE_TARGET static inline vf NOISE_FADE(vf t) {
+    vf inner = vf_add(vf_mul(t, vf_sub(vf_mul(t, vf_set1(6.0f)), vf_set1(15.0f))), vf_set1(10.0f));
+    return vf_mul(vf_mul(vf_mul(t, t), t), inner);
+}
+
+NOISE_TARGET static inline void NOISE_GRAD(vf *gx, vf *gz, vi a, vi b) {
+    a = vi_mul(a, vi_set1((int)3284157443u));
+    a = vi_xor(a, vi_set1((int)seed_mix));
+    b = vi_xor(b, vi_or(vi_sll(a, 16), vi_srl(a, 16)));
+    b = vi_mul(b, vi_set1((int)1911520717u));
+    a = vi_xor(a, vi_or(vi_sll(b, 16), vi_srl(b, 16)));
+    a = vi_mul(a, vi_set1((int)2048419325u));
+
+    if (gradient_bits) {
+        vi i = vi_srl(a, 32 - gradient_bits);
+        *gx = vf_gather(gradient_x, i);
+        *gz = vf_gather(gradient_z, i);
+        return;
+    }
+
+    // Reading the hash as signed gives an angle in [-Pi, Pi), the same
+    // direction as the unsigned [0, 2*Pi) one used by grad()
+    vf r = vf_mul(vi_to_vf(a), vf_set1((float)(M_PI / 2147483648.0)));
+
+    // sincos: reduce to [-Pi/4, Pi/4] around the nearest quadrant
+    vf y = vf_round(vf_mul(r, vf_set1((float)M_2_PI)));
+    vi q = vf_to_vi(y);
+
+    r = vf_sub(r, vf_mul(y, vf_set1(1.5707963705062866f)));
+    r = vf_sub(r, vf_mul(y, vf_set1(-4.3711388286737929e-8f)));
+
+    vf r2 = vf_mul(r, r);
+
+    vf s = vf_add(vf_mul(r2, vf_set1(-1.9515295891e-4f)), vf_set1(8.3321608736e-3f));
+    s = vf_add(vf_mul(r2, s), vf_set1(-1.6666654611e-1f));
+    s = vf_add(vf_mul(vf_mul(r2, s), r), r);
+
+    vf c = vf_add(vf_mul(r2, vf_set1(2.443315711809948e-5f)), vf_set1(-1.388731625493765e-3f));
+    c = vf_add(vf_mul(r2, c), vf_set1(4.166664568298827e-2f));
+    c = vf_add(vf_mul(vf_mul(r2, r2), c), vf_sub(vf_set1(1.0f), vf_mul(r2, vf_set1(0.5f))));
+
+    vi swap = vi_eq(vi_and(q, vi_set1(1)), vi_set1(1));
+    vi sin_sign = vi_sll(vi_and(q, vi_set1(2)), 30);
+    vi cos_sign = vi_sll(vi_and(vi_add(q, vi_set1(1)), vi_set1(2)), 30);
+
+    *gx = vi_bits(vi_xor(vi_select(vf_bits(s), vf_bits(c), swap), sin_sign));
+    *gz = vi_bits(vi_xor(vi_select(vf_bits(c), vf_bits(s), swap), cos_sign));
+}
+
+NOISE_TARGET static void NOISE_KERNEL(float *out, float x, float z, float step, int count) {
+    // z is shared by the whole row, so its lattice cell is resolved once
+    float zf;
+    int zi = lattice(z, &zf);
+
+    vi zi0 = vi_set1(zi + 0), zi1 = vi_set1(zi + 1);
+    vf zf0 = vf_set1(zf), zf1 = vf_set1(zf - 1.0f);
+    vf fz = vf_set1(fade(zf));
+
+    vf lanes = vf_lanes();
+
+    int i = 0;
+    for (; i + LANES <= count; i += LANES) {
+        vf vx = vf_add(vf_set1(x), vf_mul(vf_add(vf_set1((float)i), lanes), vf_set1(step)));
+
+        // Same cell selection as noise(): truncate, divide, step down when negative
+        vi t = vf_to_vi(vx);
+        vi xi_pos = vi_sra(t, GRID_SHIFT);
+        vi xi_neg = vi_sub(vi_sra(vi_add(t, vi_set1(GRID_SIZE - 1)), GRID_SHIFT), vi_set1(1));
+        vi xi = vi_select(xi_pos, xi_neg, vf_lt(vx, vf_set1(0.0f)));
+        vi xi1 = vi_add(xi, vi_set1(1));
+
+        vf xf0 = vf_mul(vf_sub(vx, vi_to_vf(vi_sll(xi, GRID_SHIFT))), vf_set1(1.0f / GRID_SIZE));
+        vf xf1 = vf_sub(xf0, vf_set1(1.0f));
+        vf fx = NOISE_FADE(xf0);
+
+        vf g0x, g0z, g1x, g1z, g2x, g2z, g3x, g3z;
+        NOISE_GRAD(&g0x, &g0z, xi, zi0);
+        NOISE_GRAD(&g1x, &g1z, xi1, zi0);
+        NOISE_GRAD(&g2x, &g2z, xi, zi1);
+        NOISE_GRAD(&g3x, &g3z, xi1, zi1);
+
+        vf u0 = vf_add(vf_mul(xf0, g0x), vf_mul(zf0, g0z));
+        vf v0 = vf_add(vf_mul(xf1, g1x), vf_mul(zf0, g1z));
+        vf uv0 = vf_add(u0, vf_mul(vf_sub(v0, u0), fx));
+
+        vf u1 = vf_add(vf_mul(xf0, g2x), vf_mul(zf1, g2z));
+        vf v1 = vf_add(vf_mul(xf1, g3x), vf_mul(zf1, g3z));
+        vf uv1 = vf_add(u1, vf_mul(vf_sub(v1, u1), fx));
+
+        vf_store(out + i, vf_add(uv0, vf_mul(vf_sub(uv1, uv0), fz)));
+    }
+
+    for (; i < count; i++)
+        out[i] = noise(x + i * step, z);
+}
+
+#undef NOISE_KERNEL
+#undef NOISE_FADE
+#undef NOISE_GRAD
+#undef NOISE_TARGET
+#undef LANES
+#undef vf
+#undef vi
+#undef vf_set1
+#undef vi_set1
+#undef vf_lanes
+#undef vf_add
+#undef vf_sub
+#undef vf_mul
+#undef vf_round
+#undef vf_lt
+#undef vf_store
+#undef vi_add
+#undef vi_sub
+#undef vi_mul
+#undef vi_and
+#undef vi_or
+#undef vi_xor
+#undef vi_sra
+#undef vi_sll
+#undef vi_srl
+#undef vi_eq
+#undef vi_select
+#undef vf_to_vi
+#undef vi_to_vf
+#undef vf_bits
+#undef vi_bits
+#undef vf_gather
@@ -0,0 +1,280 @@
+#include "pyramid.h"
+
+void pyramid_row(height_t *data, int level, int j);
+void corner_bounds(height_t *data, int level, int j);
+void cell_bounds(const height_t *data, int level, int i, int j, float *low, float *high);
+int raycast_cell(const height_t *data, int base, int level, int i, int j, vec3 origin, vec3 dir, float t0, float t1,
+                 float *distance);
+int clip_ray(vec3 origin, vec3 dir, float min_x, float min_z, float max_x, float max_z, float *t0, float *t1);
+int intersect_triangle(vec3 origin, vec3 dir, vec3 a, vec3 b, vec3 c, float *t);
+
+void generate_pyramid(height_t *data, int base, float *min_height, float *max_height) {
+    // One pass down the rows of level base. Each row lets every level above
+    // catch up as far as its source rows allow, so a level reads rows that
+    // were only just written instead of a whole level at a time.
+    int done[CHUNK_MIPS] = {0};
+
+    for (int row = 0; row < CHUNK_MIP_SIDE(base); row++) {
+        // Nothing below a level sampled directly, its cells are bounded by their corners
+        if (base > 0 && row > 0)
+            corner_bounds(data, base, row - 1);
+
+        done[base] = row + 1;
+
+        for (int level = base + 1; level < CHUNK_MIPS; level++) {
+            int src_side = CHUNK_MIP_SIDE(level - 1), side = CHUNK_MIP_SIDE(level);
+
+            // Row j reads source rows 2j - 1 to 2j + 2, as far as there are any
+            while (done[level] < side) {
+                int needed = 2 * done[level] + 3 < src_side ? 2 * done[level] + 3 : src_side;
+                if (done[level - 1] < needed)
+                    break;
+
+                pyramid_row(data, level, done[level]);
+                done[level]++;
+            }
+        }
+    }
+
+    *min_height = DECODE_HEIGHT((float)data[chunk_bounds_offset(CHUNK_MIPS - 1, 0)]);
+    *max_height = DECODE_HEIGHT((float)data[chunk_bounds_offset(CHUNK_MIPS - 1, 1)]);
+}
+
+void pyramid_row(height_t *data, int level, int j) {
+    const height_t *src = data + chunk_mip_offset(level - 1);
+    height_t *dst = data + chunk_mip_offset(level);
+    int src_side = CHUNK_MIP_SIDE(level - 1), side = CHUNK_MIP_SIDE(level);
+
+    height_t *low = data + chunk_bounds_offset(level, 0);
+    height_t *high = data + chunk_bounds_offset(level, 1);
+    const height_t *src_low = data + chunk_bounds_offset(level - 1, 0);
+    const height_t *src_high = data + chunk_bounds_offset(level - 1, 1);
+    int cells = CHUNK_SIZE >> level;
+
+    for (int i = 0; i < side; i++) {
+        const height_t *s = src + i * 2 + j * 2 * src_side;
+
+        if (i == 0 || j == 0 || i == side - 1 || j == side - 1) {
+            dst[i + j * side] = *s;
+            continue;
+        }
+
+        // 1-2-1 tent over the 3x3 samples around it
+        float sum = DECODE_HEIGHT(s[-src_side - 1]) + DECODE_HEIGHT(s[-src_side + 1]) +
+                    DECODE_HEIGHT(s[src_side - 1]) + DECODE_HEIGHT(s[src_side + 1]) +
+                    2.0f * (DECODE_HEIGHT(s[-src_side]) + DECODE_HEIGHT(s[-1]) + DECODE_HEIGHT(s[1]) +
+                            DECODE_HEIGHT(s[src_side])) +
+                    4.0f * DECODE_HEIGHT(s[0]);
+
+        dst[i + j * side] = ENCODE_HEIGHT(sum / 16.0f);
+    }
+
+    if (j == cells)
+        return;
+
+    for (int i = 0; i < cells; i++) {
+        height_t min, max;
+
+        if (level == 1) {
+            // The 3x3 heights the cell spans
+            const height_t *s = src + i * 2 + j * 2 * src_side;
+            min = max = s[0];
+
+            for (int z = 0; z < 3; z++)
+                for (int x = 0; x < 3; x++) {
+                    height_t h = s[x + z * src_side];
+                    min = h < min ? h : min;
+                    max = h > max ? h : max;
+                }
+        } else {
+            // The four cells below it
+            int src_cells = cells * 2, c = i * 2 + j * 2 * src_cells;
+
+            min = src_low[c];
+            max = src_high[c];
+
+            int children[3] = {c + 1, c + src_cells, c + src_cells + 1};
+            for (int k = 0; k < 3; k++) {
+                min = src_low[children[k]] < min ? src_low[children[k]] : min;
+                max = src_high[children[k]] > max ? src_high[children[k]] : max;
+            }
+        }
+
+        low[i + j * cells] = min;
+        high[i + j * cells] = max;
+    }
+}
+
+void corner_bounds(height_t *data, int level, int j) {
+    const height_t *src = data + chunk_mip_offset(level);
+    height_t *low = data + chunk_bounds_offset(level, 0);
+    height_t *high = data + chunk_bounds_offset(level, 1);
+    int side = CHUNK_MIP_SIDE(level), cells = CHUNK_SIZE >> level;
+
+    for (int i = 0; i < cells; i++) {
+        const height_t *s = src + i + j * side;
+        height_t corners[4] = {s[0], s[1], s[side], s[side + 1]};
+        height_t min = corners[0], max = corners[0];
+
+        for (int k = 1; k < 4; k++) {
+            min = corners[k] < min ? corners[k] : min;
+            max = corners[k] > max ? corners[k] : max;
+        }
+
+        low[i + j * cells] = min;
+        high[i + j * cells] = max;
+    }
+}
+
+int raycast_chunk(const height_t *data, int base, vec3 origin, vec3 dir, float max_distance, float *distance) {
+    float t0, t1;
+    if (!clip_ray(origin, dir, 0.0f, 0.0f, CHUNK_SIZE, CHUNK_SIZE, &t0, &t1))
+        return 0;
+
+    t0 = fmaxf(t0, 0.0f);
+    t1 = fminf(t1, max_distance);
+    if (t0 > t1)
+        return 0;
+
+    return raycast_cell(data, base, CHUNK_MIPS - 1, 0, 0, origin, dir, t0, t1, distance);
+}
+
+void cell_bounds(const height_t *data, int level, int i, int j, float *low, float *high) {
+    if (level > 0) {
+        int cells = CHUNK_SIZE >> level;
+        *low = DECODE_HEIGHT((float)data[chunk_bounds_offset(level, 0) + i + j * cells]);
+        *high = DECODE_HEIGHT((float)data[chunk_bounds_offset(level, 1) + i + j * cells]);
+        return;
+    }
+
+    // Single cells are bounded by their corners
+    const height_t *s = data + i + j * CHUNK_SIZE_1;
+    height_t corners[4] = {s[0], s[1], s[CHUNK_SIZE_1], s[CHUNK_SIZE_1 + 1]};
+
+    *low = *high = DECODE_HEIGHT((float)corners[0]);
+    for (int k = 1; k < 4; k++) {
+        *low = fminf(*low, DECODE_HEIGHT((float)corners[k]));
+        *high = fmaxf(*high, DECODE_HEIGHT((float)corners[k]));
+    }
+}
+
+int raycast_cell(const height_t *data, int base, int level, int i, int j, vec3 origin, vec3 dir, float t0, float t1,
+                 float *distance) {
+    float low, high;
+    cell_bounds(data, level, i, j, &low, &high);
+
+    // Over the whole cell while the ray is above its highest point
+    if (fminf(origin[1] + dir[1] * t0, origin[1] + dir[1] * t1) > high)
+        return 0;
+
+    if (level == base) {
+        // The two triangles of the quad, as terrain_generate_lod_indices lays them out
+        int side = CHUNK_MIP_SIDE(level), size = 1 << level;
+        const height_t *s = data + chunk_mip_offset(level) + i + j * side;
+        float x = i * size, z = j * size;
+
+        vec3 a = {x, DECODE_HEIGHT((float)s[0]), z};
+        vec3 b = {x + size, DECODE_HEIGHT((float)s[1]), z};
+        vec3 c = {x, DECODE_HEIGHT((float)s[side]), z + size};
+        vec3 d = {x + size, DECODE_HEIGHT((float)s[side + 1]), z + size};
+
+        float t, nearest = INFINITY;
+        if (intersect_triangle(origin, dir, a, b, c, &t))
+            nearest = t;
+        if (intersect_triangle(origin, dir, d, c, b, &t))
+            nearest = fminf(nearest, t);
+
+        // A little slack so a hit exactly on a shared edge is not lost between cells
+        if (nearest < t0 - 1e-4f || nearest > t1 + 1e-4f)
+            return 0;
+
+        *distance = nearest;
+        return 1;
+    }
+
+    // Children in the order the ray enters them, so the first hit is the nearest
+    int size = 1 << (level - 1);
+    int child_i[4], child_j[4], count = 0;
+    float child_t0[4], child_t1[4];
+
+    for (int c = 0; c < 4; c++) {
+        int ci = i * 2 + c % 2, cj = j * 2 + c / 2;
+        float c0, c1;
+
+        if (!clip_ray(origin, dir, ci * size, cj * size, (ci + 1) * size, (cj + 1) * size, &c0, &c1))
+            continue;
+
+        c0 = fmaxf(c0, t0);
+        c1 = fminf(c1, t1);
+        if (c0 > c1)
+            continue;
+
+        int k = count++;
+        for (; k > 0 && child_t0[k - 1] > c0; k--) {
+            child_i[k] = child_i[k - 1];
+            child_j[k] = child_j[k - 1];
+            child_t0[k] = child_t0[k - 1];
+            child_t1[k] = child_t1[k - 1];
+        }
+
+        child_i[k] = ci;
+        child_j[k] = cj;
+        child_t0[k] = c0;
+        child_t1[k] = c1;
+    }
+
+    for (int k = 0; k < count; k++)
+        if (raycast_cell(data, base, level - 1, child_i[k], child_j[k], origin, dir, child_t0[k], child_t1[k],
+                         distance))
+            return 1;
+
+    return 0;
+}
+
+int clip_ray(vec3 origin, vec3 dir, float min_x, float min_z, float max_x, float max_z, float *t0, float *t1) {
+    float min[2] = {min_x, min_z}, max[2] = {max_x, max_z};
+    *t0 = -INFINITY;
+    *t1 = INFINITY;
+
+    // Slabs along x and z, y is left to the height bounds
+    for (int k = 0; k < 2; k++) {
+        float o = origin[k * 2], d = dir[k * 2];
+
+        if (d == 0.0f) {
+            if (o < min[k] || o > max[k])
+                return 0;
+            continue;
+        }
+
+        float a = (min[k] - o) / d, b = (max[k] - o) / d;
+        *t0 = fmaxf(*t0, fminf(a, b));
+        *t1 = fminf(*t1, fmaxf(a, b));
+    }
+
+    return *t0 <= *t1;
+}
+
+int intersect_triangle(vec3 origin, vec3 dir, vec3 a, vec3 b, vec3 c, float *t) {
+    // Moller-Trumbore
+    vec3 ab, ac, p, s, q;
+    vec3_sub(ab, b, a);
+    vec3_sub(ac, c, a);
+    vec3_cross(p, dir, ac);
+
+    float det = vec3_dot(ab, p);
+    if (fabsf(det) < 1e-12f)
+        return 0;
+
+    vec3_sub(s, origin, a);
+    float u = vec3_dot(s, p) / det;
+    if (u < 0.0f || u > 1.0f)
+        return 0;
+
+    vec3_cross(q, s, ab);
+    float v = vec3_dot(dir, q) / det;
+    if (v < 0.0f || u + v > 1.0f)
+        return 0;
+
+    *t = vec3_dot(ac, q) / det;
+    return *t >= 0.0f;
+}
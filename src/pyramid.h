@@ -0,0 +1,41 @@
+#ifndef PYRAMID_H
+#define PYRAMID_H
+
+// A chunk's samples as job buffers, the caches and the vertex buffer hold
+// them, part of libterrain: CHUNK_DATA_SAMPLES encoded heights, the chunk's
+// own followed by its mip pyramid (see heightfield.h). CPU only, safe on
+// worker threads.
+
+#include <math.h>
+#include <sys/types.h>
+
+#include "heightfield.h"
+#include "linmath.h"
+
+// Heights in [0, 1] as unorm16, or as floats with TERRAIN_FLOAT_HEIGHTS. Build
+// libterrain and its users with the same setting; tiles record the sample
+// size, so ones written with the other encoding are regenerated.
+#ifdef TERRAIN_FLOAT_HEIGHTS
+typedef float height_t;
+#define ENCODE_HEIGHT(h) (h)
+#define DECODE_HEIGHT(h) (h)
+#else
+typedef u_int16_t height_t;
+#define ENCODE_HEIGHT(h) ((height_t)lrintf((h) * 65535.0f))
+#define DECODE_HEIGHT(h) ((h) / 65535.0f)
+#endif
+
+// Builds the pyramid from the samples of level base in a single pass down its
+// rows, and returns the chunk's bounds from its top cell. Base 0 starts
+// from the heights; a chunk sampled directly at a coarser level has nothing
+// below base, and nothing there is read or written.
+void generate_pyramid(height_t *data, int base, float *min_height, float *max_height);
+
+// Nearest hit along origin + t * dir for t in [0, max_distance], in the
+// chunk's grid space: x and y as in the world, z counting rows from the
+// chunk's top edge. Cells the ray passes over are skipped a pyramid level at
+// a time, down to the triangles of level base. Returns 1 and sets distance on
+// a hit.
+int raycast_chunk(const height_t *data, int base, vec3 origin, vec3 dir, float max_distance, float *distance);
+
+#endif  // PYRAMID_H
@@ -0,0 +1,289 @@
+#include "quadtree.h"
+
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "heightfield.h"
+#include "timer.h"
+
+int generate_patch_indices(u_int16_t *indices, int min_x, int min_z, int cells);
+int select_node(quadtree_t *quadtree, frustum_t frustum, int level, int x, int z, float min_height, float max_height);
+cache_entry_t *resident_node(quadtree_t *quadtree, int level, int x, int z);
+int box_in_range(vec3 min, vec3 max, vec3 pos, float range);
+void add_draw(quadtree_t *quadtree, int level, int x, int z, int slot, int part);
+
+void init_quadtree(quadtree_t *quadtree, int levels, int budget_us) {
+    quadtree->levels = levels < MIN_QUADTREE_LEVELS ? MIN_QUADTREE_LEVELS
+                     : levels > MAX_QUADTREE_LEVELS ? MAX_QUADTREE_LEVELS
+                                                    : levels;
+
+    // The top level covers the whole root window
+    for (int l = 0; l < quadtree->levels; l++)
+        quadtree->ranges[l] = QUADTREE_RANGE * (QUADTREE_PATCH << l);
+    quadtree->ranges[quadtree->levels - 1] = FLT_MAX;
+
+    quadtree->budget_us = budget_us;
+    quadtree->draws = (quadtree_draw_t *)malloc(sizeof(quadtree_draw_t) * MAX_QUADTREE_NODES);
+    quadtree->draws_count = 0;
+
+    quadtree->nodes_drawn = quadtree->nodes_culled = quadtree->nodes_deferred = 0;
+    quadtree->nodes_generated = 0;
+    quadtree->generate_time = 0;
+
+    // One patch for every node: the whole of it, then the quarters drawn
+    // where a child is out of its range
+    int half = QUADTREE_PATCH / 2;
+    u_int16_t *indices = (u_int16_t *)malloc(sizeof(u_int16_t) * QUADTREE_PATCH * QUADTREE_PATCH * 6 * 2);
+
+    quadtree->full_count = generate_patch_indices(indices, 0, 0, QUADTREE_PATCH);
+
+    u_int16_t *quarter = indices + quadtree->full_count;
+    for (int c = 0; c < 4; c++) {
+        quadtree->quarter_count = generate_patch_indices(quarter, c % 2 * half, c / 2 * half, half);
+        quarter += quadtree->quarter_count;
+    }
+
+    // Positions come from gl_VertexID, so the VAO only carries the indices
+    glGenVertexArrays(1, &quadtree->vao);
+    glBindVertexArray(quadtree->vao);
+
+    glGenBuffers(1, &quadtree->ebo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, quadtree->ebo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(u_int16_t) * (quarter - indices), indices, GL_STATIC_DRAW);
+
+    free(indices);
+
+    // GL 3.3 only promises 256 layers
+    GLint max_layers;
+    glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &max_layers);
+    quadtree->slots = max_layers < QUADTREE_SLOTS ? max_layers : QUADTREE_SLOTS;
+
+    size_t patch_bytes = sizeof(float) * QUADTREE_PATCH_1 * QUADTREE_PATCH_1;
+    init_cache(&quadtree->cache, patch_bytes * quadtree->slots, patch_bytes);
+
+    quadtree->frame = 0;
+    quadtree->stamps = (int *)calloc(quadtree->slots, sizeof(int));
+
+    glGenTextures(1, &quadtree->texture);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, quadtree->texture);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_R32F, QUADTREE_PATCH_1, QUADTREE_PATCH_1, quadtree->slots, 0, GL_RED,
+                 GL_FLOAT, NULL);
+
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    init_noise();
+}
+
+void free_quadtree(quadtree_t *quadtree) {
+    free(quadtree->draws);
+    free(quadtree->stamps);
+    free_cache(&quadtree->cache);
+
+    glDeleteVertexArrays(1, &quadtree->vao);
+    glDeleteBuffers(1, &quadtree->ebo);
+    glDeleteTextures(1, &quadtree->texture);
+}
+
+void update_quadtree(quadtree_t *quadtree, vec3 pos) {
+    vec3_set(quadtree->position, pos[0], pos[1], pos[2]);
+}
+
+void draw_quadtree(quadtree_t *quadtree, GLuint shader, frustum_t frustum) {
+    quadtree->frame_start = get_time();
+    quadtree->frame++;
+    quadtree->draws_count = 0;
+    quadtree->nodes_drawn = quadtree->nodes_culled = quadtree->nodes_deferred = 0;
+
+    // Selection only descends into nodes in range and in view, so it costs
+    // in proportion to what is drawn however large the world
+    int top = quadtree->levels - 1;
+    int root_size = QUADTREE_PATCH << top;
+    int root_x = (int)floorf(quadtree->position[0] / root_size);
+    int root_z = (int)floorf(quadtree->position[2] / root_size);
+
+    for (int dz = -QUADTREE_ROOTS / 2; dz <= QUADTREE_ROOTS / 2; dz++)
+        for (int dx = -QUADTREE_ROOTS / 2; dx <= QUADTREE_ROOTS / 2; dx++)
+            select_node(quadtree, frustum, top, root_x + dx, root_z + dz, 0.0f, 1.0f);
+
+    glBindVertexArray(quadtree->vao);
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, quadtree->texture);
+
+    glUniform1i(glGetUniformLocation(shader, "heights"), 0);
+    glUniform3fv(glGetUniformLocation(shader, "camera"), 1, quadtree->position);
+
+    GLint slot_loc = glGetUniformLocation(shader, "slot");
+    GLint origin_loc = glGetUniformLocation(shader, "origin");
+    GLint spacing_loc = glGetUniformLocation(shader, "spacing");
+    GLint morph_loc = glGetUniformLocation(shader, "morph");
+
+    for (int n = 0; n < quadtree->draws_count; n++) {
+        quadtree_draw_t *draw = &quadtree->draws[n];
+        int size = QUADTREE_PATCH << draw->level;
+
+        // Morph from QUADTREE_MORPH of the way through the level's range to its end
+        float start = FLT_MAX, scale = 0.0f;
+        if (draw->level < top) {
+            float inner = draw->level ? quadtree->ranges[draw->level - 1] : 0.0f;
+            float range = quadtree->ranges[draw->level];
+
+            start = inner + (range - inner) * QUADTREE_MORPH;
+            scale = 1.0f / (range - start);
+        }
+
+        glUniform1i(slot_loc, draw->slot);
+        glUniform2f(origin_loc, (float)draw->x * size, (float)draw->z * size);
+        glUniform1f(spacing_loc, (float)(1 << draw->level));
+        glUniform2f(morph_loc, start, scale);
+
+        if (draw->part == QUADTREE_FULL) {
+            glDrawElements(GL_TRIANGLES, quadtree->full_count, GL_UNSIGNED_SHORT, (void *)0);
+        } else {
+            size_t offset = quadtree->full_count + draw->part * quadtree->quarter_count;
+            glDrawElements(GL_TRIANGLES, quadtree->quarter_count, GL_UNSIGNED_SHORT,
+                           (void *)(offset * sizeof(u_int16_t)));
+        }
+    }
+}
+
+float quadtree_view_distance(quadtree_t *quadtree) {
+    // The camera is always in the middle root, so one more root than the window's half width
+    return (QUADTREE_ROOTS / 2 + 1) * (float)(QUADTREE_PATCH << (quadtree->levels - 1));
+}
+
+int generate_patch_indices(u_int16_t *indices, int min_x, int min_z, int cells) {
+    int count = 0;
+
+    for (int j = min_z; j < min_z + cells; j++)
+        for (int i = min_x; i < min_x + cells; i++) {
+            // Rows run towards +z, as in the clipmap
+            indices[count++] = (i + 0) + (j + 0) * QUADTREE_PATCH_1;
+            indices[count++] = (i + 0) + (j + 1) * QUADTREE_PATCH_1;
+            indices[count++] = (i + 1) + (j + 0) * QUADTREE_PATCH_1;
+            indices[count++] = (i + 1) + (j + 1) * QUADTREE_PATCH_1;
+            indices[count++] = (i + 1) + (j + 0) * QUADTREE_PATCH_1;
+            indices[count++] = (i + 0) + (j + 1) * QUADTREE_PATCH_1;
+        }
+
+    return count;
+}
+
+// Returns 0 when the node is out of its range or has no heights yet, for
+// the parent to draw that quarter itself. The height bounds are the
+// parent's until the node's own are known.
+int select_node(quadtree_t *quadtree, frustum_t frustum, int level, int x, int z, float min_height, float max_height) {
+    float size = (float)(QUADTREE_PATCH << level);
+
+    vec3 min = {x * size, min_height, z * size};
+    vec3 max = {min[0] + size, max_height, min[2] + size};
+
+    if (!box_in_range(min, max, quadtree->position, quadtree->ranges[level]))
+        return 0;
+
+    if (!aabb_in_frustum(frustum, min, max)) {
+        quadtree->nodes_culled++;
+        return 1;
+    }
+
+    cache_entry_t *entry = resident_node(quadtree, level, x, z);
+    if (!entry) {
+        quadtree->nodes_deferred++;
+        return 0;
+    }
+
+    min[1] = entry->min_height;
+    max[1] = entry->max_height;
+
+    if (!aabb_in_frustum(frustum, min, max)) {
+        quadtree->nodes_culled++;
+        return 1;
+    }
+
+    int slot = (int)(entry - quadtree->cache.entries);
+
+    if (level == 0 || !box_in_range(min, max, quadtree->position, quadtree->ranges[level - 1])) {
+        add_draw(quadtree, level, x, z, slot, QUADTREE_FULL);
+        return 1;
+    }
+
+    for (int c = 0; c < 4; c++)
+        if (!select_node(quadtree, frustum, level - 1, x * 2 + c % 2, z * 2 + c / 2, min[1], max[1]))
+            add_draw(quadtree, level, x, z, slot, c);
+
+    return 1;
+}
+
+cache_entry_t *resident_node(quadtree_t *quadtree, int level, int x, int z) {
+    // Levels share the cache, so they are folded into the key
+    int key_x = x * MAX_QUADTREE_LEVELS + level;
+
+    cache_t *cache = &quadtree->cache;
+
+    // Only a hit is counted and refreshed here; a patch waiting for a frame
+    // with time to spare counts as one miss, once it is generated
+    cache_entry_t *entry = peek_cached(cache, key_x, z);
+    if (entry) {
+        entry = find_cached(cache, key_x, z);
+        quadtree->stamps[entry - cache->entries] = quadtree->frame;
+        return entry;
+    }
+
+    // Roots are always generated, everything else waits for a frame with time to spare
+    double start = get_time();
+    if (level < quadtree->levels - 1 && (start - quadtree->frame_start) * 1e6 > quadtree->budget_us)
+        return NULL;
+
+    // Evicting the least recently used patch would overwrite a layer already
+    // queued to draw once this frame has used every slot: wait for the next
+    if (cache->count == cache->capacity && quadtree->stamps[cache->tail - cache->entries] == quadtree->frame)
+        return NULL;
+
+    entry = insert_cached(cache, key_x, z);
+    quadtree->stamps[entry - cache->entries] = quadtree->frame;
+    miss_cached(cache);
+
+    float spacing = (float)(1 << level);
+    float size = spacing * QUADTREE_PATCH;
+
+    float *heights = (float *)entry->data;
+    terrain_generate_grid(x * size, z * size, spacing, QUADTREE_PATCH_1, QUADTREE_PATCH_1, heights);
+    terrain_height_bounds(heights, QUADTREE_PATCH_1 * QUADTREE_PATCH_1, &entry->min_height, &entry->max_height);
+
+    glBindTexture(GL_TEXTURE_2D_ARRAY, quadtree->texture);
+    glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, (int)(entry - quadtree->cache.entries), QUADTREE_PATCH_1,
+                    QUADTREE_PATCH_1, 1, GL_RED, GL_FLOAT, heights);
+
+    quadtree->nodes_generated++;
+    quadtree->generate_time += get_time() - start;
+
+    return entry;
+}
+
+int box_in_range(vec3 min, vec3 max, vec3 pos, float range) {
+    float d2 = 0.0f;
+
+    for (int i = 0; i < 3; i++) {
+        float d = pos[i] < min[i] ? min[i] - pos[i] : pos[i] > max[i] ? pos[i] - max[i] : 0.0f;
+        d2 += d * d;
+    }
+
+    return d2 <= range * range;
+}
+
+void add_draw(quadtree_t *quadtree, int level, int x, int z, int slot, int part) {
+    if (quadtree->draws_count == MAX_QUADTREE_NODES)
+        return;
+
+    quadtree_draw_t *draw = &quadtree->draws[quadtree->draws_count++];
+    draw->level = level;
+    draw->x = x;
+    draw->z = z;
+    draw->slot = slot;
+    draw->part = part;
+
+    quadtree->nodes_drawn++;
+}
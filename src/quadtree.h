@@ -0,0 +1,79 @@
+#ifndef QUADTREE_H
+#define QUADTREE_H
+
+#include "glfw.h"
+#include "cache.h"
+#include "frustum.h"
+#include "linmath.h"
+
+// CDLOD: a quadtree over the world where every node, whatever its size, is
+// drawn with the same patch of QUADTREE_PATCH x QUADTREE_PATCH cells. Nodes
+// are selected by distance ranges that double with each level, and vertices
+// morph towards the next level's grid as they approach the end of their
+// range so nothing pops when a node splits or merges.
+
+#define QUADTREE_PATCH 32                       // cells per node side, even
+#define QUADTREE_PATCH_1 (QUADTREE_PATCH + 1)   // vertices per node side
+#define QUADTREE_RANGE 4.0f                     // level ranges in node sizes, keeps neighbours within a level
+#define QUADTREE_MORPH 0.7f                     // fraction of a range before morphing starts
+#define QUADTREE_ROOTS 3                        // root nodes per side of the window around the camera
+#define QUADTREE_SLOTS 2048                     // resident node height patches, more than a frame touches
+#define MAX_QUADTREE_NODES 4096                 // draws per frame
+#define MIN_QUADTREE_LEVELS 1
+#define MAX_QUADTREE_LEVELS 12
+#define DEFAULT_QUADTREE_LEVELS 8
+
+enum {
+    QUADTREE_FULL = -1,  // the whole node, otherwise the quarter 0-3 whose child was not selected
+};
+
+struct _quadtree_draw_t {
+    int level, x, z;  // node coordinates in units of its size
+    int slot;         // texture layer holding its heights
+    int part;         // QUADTREE_FULL or a quarter
+};
+
+typedef struct _quadtree_draw_t quadtree_draw_t;
+
+struct _quadtree_t {
+    int levels;
+    float ranges[MAX_QUADTREE_LEVELS];
+
+    // Node heights by (level, x, z); an entry's index is its texture layer.
+    // stamps holds the last frame each was used in, so none drawn this frame
+    // is evicted.
+    cache_t cache;
+    int slots;
+    int frame, *stamps;
+
+    vec3 position;
+    int budget_us;
+    double frame_start;
+
+    quadtree_draw_t *draws;
+    int draws_count;
+
+    // Index ranges in ebo: the full patch, then each quarter
+    int full_count, quarter_count;
+
+    // Statistics for the last frame
+    int nodes_drawn, nodes_culled, nodes_deferred;
+
+    // Totals since init
+    int nodes_generated;
+    double generate_time;
+
+    GLuint vao, ebo, texture;
+};
+
+typedef struct _quadtree_t quadtree_t;
+
+void init_quadtree(quadtree_t *quadtree, int levels, int budget_us);
+void free_quadtree(quadtree_t *quadtree);
+
+void update_quadtree(quadtree_t *quadtree, vec3 pos);
+void draw_quadtree(quadtree_t *quadtree, GLuint shader, frustum_t frustum);
+
+float quadtree_view_distance(quadtree_t *quadtree);
+
+#endif  // QUADTREE_H
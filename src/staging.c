@@ -0,0 +1,148 @@
+#include "staging.h"
+
+#include <string.h>
+
+// From GL 4.4 / GL_ARB_buffer_storage, missing from the 3.3 headers
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+
+typedef void (*buffer_storage_t)(GLenum target, GLsizeiptr size, const void *data, GLbitfield flags);
+
+int has_extension(const char *name);
+void begin_segment(staging_t *staging);
+
+void init_staging(staging_t *staging, size_t segment_size, gl_proc_loader_t get_proc) {
+    staging->segment_size = segment_size;
+    staging->mapped = NULL;
+    staging->segment = 0;
+    staging->offset = 0;
+    staging->stalls = 0;
+
+    for (int i = 0; i < STAGING_SEGMENTS; i++)
+        staging->fences[i] = NULL;
+
+    buffer_storage_t buffer_storage = NULL;
+    if (get_proc && has_extension("GL_ARB_buffer_storage"))
+        buffer_storage = (buffer_storage_t)get_proc("glBufferStorage");
+
+    glGenBuffers(1, &staging->buffer);
+    glBindBuffer(GL_COPY_READ_BUFFER, staging->buffer);
+
+    if (buffer_storage) {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        size_t size = segment_size * STAGING_SEGMENTS;
+
+        buffer_storage(GL_COPY_READ_BUFFER, size, NULL, flags);
+        staging->mapped = (char *)glMapBufferRange(GL_COPY_READ_BUFFER, 0, size, flags);
+
+        // Immutable storage cannot be orphaned: start over with a fresh buffer
+        if (!staging->mapped) {
+            glDeleteBuffers(1, &staging->buffer);
+            glGenBuffers(1, &staging->buffer);
+            glBindBuffer(GL_COPY_READ_BUFFER, staging->buffer);
+        }
+    }
+
+    if (!staging->mapped)
+        glBufferData(GL_COPY_READ_BUFFER, segment_size, NULL, GL_STREAM_DRAW);
+}
+
+void free_staging(staging_t *staging) {
+    for (int i = 0; i < STAGING_SEGMENTS; i++)
+        if (staging->fences[i])
+            glDeleteSync(staging->fences[i]);
+
+    if (staging->mapped) {
+        glBindBuffer(GL_COPY_READ_BUFFER, staging->buffer);
+        glUnmapBuffer(GL_COPY_READ_BUFFER);
+    }
+
+    glDeleteBuffers(1, &staging->buffer);
+}
+
+void stage_upload(staging_t *staging, GLuint buffer, size_t offset, const void *data, size_t size) {
+    if (staging->offset + size > staging->segment_size)
+        end_staging_frame(staging);
+
+    if (staging->offset == 0)
+        begin_segment(staging);
+
+    glBindBuffer(GL_COPY_READ_BUFFER, staging->buffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+
+    size_t source = staging->offset;
+
+    if (staging->mapped) {
+        source += staging->segment * staging->segment_size;
+        memcpy(staging->mapped + source, data, size);
+    } else {
+        // Orphaned at the start of the segment, so nothing can be reading this range
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT;
+        void *target = glMapBufferRange(GL_COPY_READ_BUFFER, source, size, flags);
+
+        // Let the driver copy it instead when the range cannot be mapped
+        if (target) {
+            memcpy(target, data, size);
+            glUnmapBuffer(GL_COPY_READ_BUFFER);
+        } else {
+            glBufferSubData(GL_COPY_READ_BUFFER, source, size, data);
+        }
+    }
+
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, source, offset, size);
+    staging->offset += size;
+}
+
+void end_staging_frame(staging_t *staging) {
+    if (staging->offset == 0)
+        return;
+
+    // Fence after the copies: the segment is free again once they have run
+    if (staging->mapped) {
+        staging->fences[staging->segment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        staging->segment = (staging->segment + 1) % STAGING_SEGMENTS;
+    }
+
+    staging->offset = 0;
+}
+
+const char *staging_mode(staging_t *staging) {
+    return staging->mapped ? "persistent" : "orphaning";
+}
+
+void begin_segment(staging_t *staging) {
+    if (!staging->mapped) {
+        // Orphan: the driver hands out fresh storage while pending copies keep the old
+        glBindBuffer(GL_COPY_READ_BUFFER, staging->buffer);
+        glBufferData(GL_COPY_READ_BUFFER, staging->segment_size, NULL, GL_STREAM_DRAW);
+        return;
+    }
+
+    GLsync fence = staging->fences[staging->segment];
+    if (!fence)
+        return;
+
+    // Only blocks when uploads run STAGING_SEGMENTS segments ahead of the GPU
+    if (glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+        staging->stalls++;
+
+        while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED)
+            ;
+    }
+
+    glDeleteSync(fence);
+    staging->fences[staging->segment] = NULL;
+}
+
+int has_extension(const char *name) {
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+
+    for (int i = 0; i < count; i++)
+        if (!strcmp((const char *)glGetStringi(GL_EXTENSIONS, i), name))
+            return 1;
+
+    return 0;
+}
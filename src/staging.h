@@ -0,0 +1,42 @@
+#ifndef STAGING_H
+#define STAGING_H
+
+#include <stddef.h>
+
+#include "glfw.h"
+
+// Chunk uploads stream through a staging ring and are copied into place on
+// the GPU, so the CPU never writes a buffer a pending draw may still read
+#define STAGING_SEGMENTS 3
+
+typedef void *(*gl_proc_loader_t)(const char *name);
+
+struct _staging_t {
+    GLuint buffer;
+    size_t segment_size;
+
+    // Persistent mapping of all segments with GL_ARB_buffer_storage, one fence
+    // per segment. NULL when falling back to orphaning a single segment.
+    char *mapped;
+    GLsync fences[STAGING_SEGMENTS];
+
+    int segment;
+    size_t offset;  // bytes used in the current segment
+
+    int stalls;  // times a segment was still in use by the GPU
+};
+
+typedef struct _staging_t staging_t;
+
+// get_proc resolves GL entry points beyond 3.3, NULL forces the fallback
+void init_staging(staging_t *staging, size_t segment_size, gl_proc_loader_t get_proc);
+void free_staging(staging_t *staging);
+
+void stage_upload(staging_t *staging, GLuint buffer, size_t offset, const void *data, size_t size);
+
+// Call once per frame after the last upload
+void end_staging_frame(staging_t *staging);
+
+const char *staging_mode(staging_t *staging);
+
+#endif  // STAGING_H
@@ -2,32 +2,114 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "chunk.h"
+#include "heightfield.h"
+#include "timer.h"
+
+// How height_t reaches the vertex shader
+#ifdef TERRAIN_FLOAT_HEIGHTS
+#define HEIGHT_TYPE GL_FLOAT
+#define HEIGHT_NORMALIZED GL_FALSE
+#else
+#define HEIGHT_TYPE GL_UNSIGNED_SHORT
+#define HEIGHT_NORMALIZED GL_TRUE
+#endif
+
+// A single chunk's vertices are addressable with 16-bit indices
+typedef u_int16_t index_t;
+#define INDEX_TYPE GL_UNSIGNED_SHORT
+
+// A chunk that will enter the window, and when
+struct _prefetch_t {
+    int chunk_x, chunk_z;
+    float time;       // seconds until needed
+    float alignment;  // cosine between the look direction and the chunk
+};
+
+typedef struct _prefetch_t prefetch_t;
+
+#define MAX_PREFETCH_CANDIDATES 512
+
+void generate_in_budget(terrain_t *terrain);
+void upload_chunk(terrain_t *terrain, int slot, height_t *data, int level);
+int chunk_lod(terrain_t *terrain, int chunk_x, int chunk_z);
+int distance_lod(terrain_t *terrain, int distance);
+int drawn_lod(terrain_t *terrain, int chunk_x, int chunk_z);
+int chunk_slot(terrain_t *terrain, int chunk_x, int chunk_z);
+int chunk_key(int chunk_x, int level);
+cache_entry_t *find_chunk(terrain_t *terrain, int chunk_x, int chunk_z, int lod, int touch, int *level);
+void load_chunk(terrain_t *terrain, int slot, height_t *data, int level, float min_height, float max_height);
+int submit_chunk(terrain_t *terrain, int chunk_x, int chunk_z, int level, int slot);
+float chunk_priority(terrain_t *terrain, int chunk_x, int chunk_z, int visible);
+float score_job(job_t *job, void *arg);
+int find_prefetch(terrain_t *terrain, int chunk_x, int chunk_z);
+void remove_prefetch(terrain_t *terrain, int chunk_x, int chunk_z);
+int in_window(int chunk_x, int chunk_z, int center_x, int center_z, int radius);
+int request_chunks(terrain_t *terrain);
+void prefetch_chunks(terrain_t *terrain);
+void update_chunks(terrain_t *terrain);
+
+void default_terrain_options(terrain_options_t *options) {
+    options->radius = 1;
+    options->hysteresis = DEFAULT_HYSTERESIS;
+    options->cache_bytes = (size_t)DEFAULT_CACHE_MB * 1024 * 1024;
+    options->tiles_dir = NULL;
+    options->threads = -1;
+    options->budget_us = DEFAULT_BUDGET_US;
+    options->prefetch_horizon = DEFAULT_PREFETCH_HORIZON;
+    options->lod = LOD_OFF;
+    options->get_proc = NULL;
+}
 
-#define CHUNKS 9
-#define CHUNK_SIZE 128
-#define CHUNK_SIZE_1 (CHUNK_SIZE + 1)
-#define CHUNK_SIZE_SQ (CHUNK_SIZE * CHUNK_SIZE)
-#define CHUNK_SIZE_1_SQ (CHUNK_SIZE_1 * CHUNK_SIZE_1)
-#define GRID_SIZE 16
-
-float noise(float x, float y);
-
-void init_terrain(terrain_t *terrain) {
-    u_int32_t indices[CHUNK_SIZE_SQ * CHUNKS * 6];
-
-    for (int n = 0; n < CHUNKS; n++)
-        for (int x = 0; x < CHUNK_SIZE; x++)
-            for (int z = 0; z < CHUNK_SIZE * 1; z++) {
-                int i = ((n * CHUNK_SIZE_SQ) + (x * CHUNK_SIZE + z)) * 6;
-                int offset = CHUNK_SIZE_1_SQ * n;
-
-                indices[i + 0] = (x + 0) + (z + 0) * CHUNK_SIZE_1 + offset;
-                indices[i + 1] = (x + 1) + (z + 0) * CHUNK_SIZE_1 + offset;
-                indices[i + 2] = (x + 0) + (z + 1) * CHUNK_SIZE_1 + offset;
-                indices[i + 3] = (x + 1) + (z + 1) * CHUNK_SIZE_1 + offset;
-                indices[i + 4] = (x + 0) + (z + 1) * CHUNK_SIZE_1 + offset;
-                indices[i + 5] = (x + 1) + (z + 0) * CHUNK_SIZE_1 + offset;
-            }
+const char *chunk_lods[] = {"off", "skirts", "stitch"};
+
+int parse_chunk_lod(const char *name) {
+    for (int i = 0; i < 3; i++)
+        if (!strcmp(name, chunk_lods[i]))
+            return i;
+
+    return -1;
+}
+
+const char *chunk_lod_name(int lod) {
+    return chunk_lods[lod];
+}
+
+void init_terrain(terrain_t *terrain, const terrain_options_t *options) {
+    int radius = options->radius;
+
+    terrain->radius = radius < MIN_RADIUS ? MIN_RADIUS : radius > MAX_RADIUS ? MAX_RADIUS : radius;
+    terrain->side = terrain->radius * 2 + 1;
+    terrain->chunks_count = terrain->side * terrain->side;
+    terrain->chunks = (chunk_t *)malloc(sizeof(chunk_t) * terrain->chunks_count);
+
+    terrain->lod = options->lod;
+    terrain->grid_vertices = terrain->lod == LOD_OFF ? CHUNK_SIZE_1_SQ : chunk_mip_offset(CHUNK_LODS);
+    terrain->slot_vertices = terrain->grid_vertices + (terrain->lod == LOD_SKIRTS ? CHUNK_SKIRT_VERTICES : 0);
+
+    // Every chunk shares one index buffer, offset per draw by its base vertex
+    int lods = terrain->lod == LOD_OFF ? 1 : CHUNK_LODS;
+    int variants = terrain->lod == LOD_STITCH ? CHUNK_STITCH_VARIANTS : 1;
+
+    index_t *indices = (index_t *)malloc(sizeof(index_t) * (CHUNK_INDICES + CHUNK_SKIRT_INDICES) * lods * variants);
+    int count = 0;
+
+    for (int lod = 0; lod < lods; lod++)
+        for (int v = 0; v < variants; v++) {
+            terrain->lod_offset[lod][v] = count;
+            count += terrain_generate_lod_indices(indices + count, lod, v);
+
+            if (terrain->lod == LOD_SKIRTS)
+                count += terrain_generate_skirt_indices(indices + count, lod);
+
+            terrain->lod_count[lod][v] = count - terrain->lod_offset[lod][v];
+        }
+
+    size_t indices_size = sizeof(index_t) * count;
+    terrain->index_bytes = indices_size;
 
     glGenVertexArrays(1, &terrain->vao);
     glBindVertexArray(terrain->vao);
@@ -35,134 +117,612 @@ void init_terrain(terrain_t *terrain) {
     // Edges
     glGenBuffers(1, &terrain->ebo);
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, terrain->ebo);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices_size, indices, GL_STATIC_DRAW);
+
+    free(indices);
 
     // Vertices
     glGenBuffers(1, &terrain->vbo);
     glBindBuffer(GL_ARRAY_BUFFER, terrain->vbo);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vec3) * CHUNK_SIZE_1_SQ * CHUNKS, NULL, GL_DYNAMIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, terrain_vertex_bytes(terrain), NULL, GL_DYNAMIC_DRAW);
 
     glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(vec3), (void *)0);
+    glVertexAttribPointer(0, 1, HEIGHT_TYPE, HEIGHT_NORMALIZED, sizeof(height_t), (void *)0);
+
+    init_staging(&terrain->staging, sizeof(height_t) * terrain->slot_vertices * STAGING_CHUNKS, options->get_proc);
+
+    init_noise();
+
+    // Leave one core to the render thread
+    int threads = options->threads;
+    if (threads < 0) {
+        threads = (int)sysconf(_SC_NPROCESSORS_ONLN) - 1;
+        if (threads < 1)
+            threads = 1;
+    }
+
+    terrain->partial = NULL;
+    terrain->budget_us = options->budget_us > 0 ? options->budget_us : 0;
+
+    // Enough buffers to refill the whole window at once, within reason
+    int buffers = terrain->chunks_count < MAX_JOB_BUFFERS ? terrain->chunks_count : MAX_JOB_BUFFERS;
+    init_jobs(&terrain->jobs, threads, buffers, sizeof(height_t) * CHUNK_DATA_SAMPLES, generate_chunk);
+
+    init_cache(&terrain->cache, options->cache_bytes, sizeof(height_t) * CHUNK_DATA_SAMPLES);
+    init_tiles(&terrain->tiles, options->tiles_dir, sizeof(height_t), CHUNK_DATA_SAMPLES);
+
+    for (int n = 0; n < terrain->chunks_count; n++)
+        terrain->chunks[n].state = CHUNK_EMPTY;
+
+    terrain->center_chunk_x = 0;
+    terrain->center_chunk_z = 0;
+
+    // Beyond half a chunk the camera could leave the window's interior
+    terrain->hysteresis = fmaxf(0.0f, fminf(options->hysteresis, CHUNK_SIZE / 2));
+
+    vec3_set(terrain->position, 0.0f, 0.0f, 0.0f);
+    vec3_set(terrain->velocity, 0.0f, 0.0f, 0.0f);
+    vec3_set(terrain->look, 0.0f, 0.0f, -1.0f);
+
+    terrain->prefetch_horizon = options->prefetch_horizon;
+    terrain->prefetch_count = 0;
+
+    terrain->chunks_drawn = 0;
+    terrain->chunks_culled = 0;
+    terrain->indices_drawn = 0;
+    terrain->grid_indices_drawn = 0;
+
+    terrain->chunks_generated = 0;
+    terrain->chunks_uploaded = 0;
+    terrain->chunks_discarded = 0;
+    terrain->chunks_prefetched = 0;
+    terrain->chunks_cancelled = 0;
+    terrain->recenters = 0;
+    terrain->generate_time = 0;
+    terrain->upload_time = 0;
 
-    update_terrain(terrain, (vec3){0, 0, 0});
+    for (int level = 0; level < CHUNK_LODS; level++) {
+        terrain->level_chunks[level] = 0;
+        terrain->level_samples[level] = 0;
+        terrain->level_time[level] = 0;
+    }
+
+    update_chunks(terrain);
 }
 
-void draw_terrain(terrain_t *terrain) {
+void draw_terrain(terrain_t *terrain, GLuint shader, frustum_t frustum) {
     glBindVertexArray(terrain->vao);
-    glDrawElements(GL_TRIANGLES, CHUNK_SIZE_SQ * CHUNKS * 6, GL_UNSIGNED_INT, 0);
+
+    GLint origin_loc = glGetUniformLocation(shader, "origin");
+    glUniform1i(glGetUniformLocation(shader, "slotVertices"), terrain->slot_vertices);
+    glUniform1i(glGetUniformLocation(shader, "gridVertices"), terrain->grid_vertices);
+
+    terrain->chunks_drawn = 0;
+    terrain->chunks_culled = 0;
+    terrain->indices_drawn = 0;
+    terrain->grid_indices_drawn = 0;
+
+    // Slots still waiting on a worker are skipped rather than drawn stale
+    for (int n = 0; n < terrain->chunks_count; n++) {
+        chunk_t *chunk = &terrain->chunks[n];
+
+        if (chunk->state != CHUNK_LOADED && chunk->state != CHUNK_REFINING)
+            continue;
+
+        float min_x = chunk->chunk_x * CHUNK_SIZE;
+        float max_z = chunk->chunk_z * CHUNK_SIZE;
+
+        vec3 min = {min_x, chunk->min_height, max_z - CHUNK_SIZE};
+        vec3 max = {min_x + CHUNK_SIZE, chunk->max_height, max_z};
+
+        if (!aabb_in_frustum(frustum, min, max)) {
+            terrain->chunks_culled++;
+            continue;
+        }
+
+        int x = chunk->chunk_x, z = chunk->chunk_z;
+        int lod = drawn_lod(terrain, x, z);
+
+        // Neighbours are at most one level coarser, see chunk_lod, except
+        // for a chunk still waiting on its finer level
+        int coarser = 0;
+        if (terrain->lod == LOD_STITCH) {
+            coarser |= drawn_lod(terrain, x - 1, z) > lod ? CHUNK_EDGE_LEFT : 0;
+            coarser |= drawn_lod(terrain, x + 1, z) > lod ? CHUNK_EDGE_RIGHT : 0;
+            coarser |= drawn_lod(terrain, x, z + 1) > lod ? CHUNK_EDGE_TOP : 0;
+            coarser |= drawn_lod(terrain, x, z - 1) > lod ? CHUNK_EDGE_BOTTOM : 0;
+        }
+
+        int count = terrain->lod_count[lod][coarser];
+
+        terrain->chunks_drawn++;
+        terrain->indices_drawn += count;
+        terrain->grid_indices_drawn += CHUNK_INDICES >> (lod * 2);
+
+        glUniform2f(origin_loc, min_x, max_z);
+
+        glDrawElementsBaseVertex(GL_TRIANGLES, count, INDEX_TYPE,
+                                 (void *)(terrain->lod_offset[lod][coarser] * sizeof(index_t)),
+                                 terrain->slot_vertices * n);
+    }
 }
 
 void free_terrain(terrain_t *terrain) {
+    free_jobs(&terrain->jobs);
+    free_cache(&terrain->cache);
+    free_tiles(&terrain->tiles);
+    free(terrain->chunks);
+
     glDeleteVertexArrays(1, &terrain->vao);
     glDeleteBuffers(1, &terrain->ebo);
     glDeleteBuffers(1, &terrain->vbo);
+    free_staging(&terrain->staging);
 }
 
-void generate_chunk(terrain_t *terrain, int chunk_x, int chunk_z, int offset) {
-    vec3 vertices[CHUNK_SIZE_1 * CHUNK_SIZE_1];
+void generate_in_budget(terrain_t *terrain) {
+    // Always at least one step, so a zero budget still makes progress
+    double end = get_time() + terrain->budget_us * 1e-6;
+    double now;
+
+    do {
+        if (!terrain->partial) {
+            if (!(terrain->partial = take_job(&terrain->jobs)))
+                return;
+
+            terrain->partial->progress = 0;
+            terrain->partial->time = 0;
+        }
 
-    float min_x = chunk_x * CHUNK_SIZE;
-    float min_z = chunk_z * CHUNK_SIZE;
+        job_t *job = terrain->partial;
+        double start = get_time();
 
-    for (int x = 0; x < CHUNK_SIZE_1; x++)
-        for (int z = 0; z < CHUNK_SIZE_1; z++) {
-            float x_ = min_x + x;
-            float z_ = min_z - z;
+        int done = generate_chunk_block(job);
 
-            vec3_set(vertices[x + z * CHUNK_SIZE_1], x_, (noise(x_, z_) + 1.0f) / 2.0f, z_);
+        now = get_time();
+        job->time += now - start;
+
+        // Only whole chunks are published, through the usual collect path
+        if (done) {
+            finish_job(&terrain->jobs, job);
+            terrain->partial = NULL;
         }
+    } while (now < end);
+}
 
-    glBindBuffer(GL_ARRAY_BUFFER, terrain->vbo);
-    glBufferSubData(GL_ARRAY_BUFFER, offset * sizeof(vertices), sizeof(vertices), vertices);
+void upload_chunk(terrain_t *terrain, int slot, height_t *data, int level) {
+    // The heights, and with LOD on the averaged levels drawn further out,
+    // from the first level the chunk has
+    int first = chunk_mip_offset(level);
+    size_t size = sizeof(height_t) * terrain->grid_vertices;
+    size_t offset = sizeof(height_t) * terrain->slot_vertices * slot;
+
+    stage_upload(&terrain->staging, terrain->vbo, offset + sizeof(height_t) * first, data + first,
+                 size - sizeof(height_t) * first);
+
+    if (terrain->lod != LOD_SKIRTS)
+        return;
+
+    // Skirt vertices repeat the edge heights, the vertex shader lowers them.
+    // Levels above the chunk's first only use every 1 << level of them.
+    height_t skirts[CHUNK_SKIRT_VERTICES];
+    const height_t *heights = data + first;
+    int side = CHUNK_MIP_SIDE(level), last = side - 1;
+
+    for (int i = 0; i < CHUNK_SIZE_1; i++) {
+        int k = i >> level;
+
+        skirts[i + CHUNK_SIZE_1 * 0] = heights[k * side];
+        skirts[i + CHUNK_SIZE_1 * 1] = heights[last + k * side];
+        skirts[i + CHUNK_SIZE_1 * 2] = heights[k];
+        skirts[i + CHUNK_SIZE_1 * 3] = heights[k + last * side];
+    }
+
+    stage_upload(&terrain->staging, terrain->vbo, offset + size, skirts, sizeof(skirts));
 }
 
-void update_terrain(terrain_t *terrain, vec3 pos) {
-    int chunk_x = (int)floor(pos[0] / CHUNK_SIZE);
-    int chunk_z = (int)ceil(pos[2] / CHUNK_SIZE);
+int chunk_lod(terrain_t *terrain, int chunk_x, int chunk_z) {
+    if (terrain->lod == LOD_OFF)
+        return 0;
 
-    if (chunk_x != terrain->center_chunk_x || chunk_z != terrain->center_chunk_z) {
-        terrain->center_chunk_x = chunk_x;
-        terrain->center_chunk_z = chunk_z;
+    int dx = abs(chunk_x - terrain->center_chunk_x);
+    int dz = abs(chunk_z - terrain->center_chunk_z);
 
-        for (int x = -1; x <= 1; x++)
-            for (int z = -1; z <= 1; z++)
-                generate_chunk(terrain, chunk_x + x, chunk_z + z, (x + 1) + (z + 1) * 3);
+    return distance_lod(terrain, dx > dz ? dx : dz);
+}
+
+int distance_lod(terrain_t *terrain, int distance) {
+    if (terrain->lod == LOD_OFF)
+        return 0;
+
+    // One level coarser each time the distance doubles, so neighbours never
+    // differ by more than one level
+    int lod = 0;
+    while (lod < CHUNK_LODS - 1 && distance >= CHUNK_LOD_DISTANCE << lod)
+        lod++;
+
+    return lod;
+}
+
+int drawn_lod(terrain_t *terrain, int chunk_x, int chunk_z) {
+    // A chunk sampled coarser than it now needs is drawn at its own level
+    // until the finer one arrives
+    int lod = chunk_lod(terrain, chunk_x, chunk_z);
+    chunk_t *chunk = &terrain->chunks[chunk_slot(terrain, chunk_x, chunk_z)];
+
+    if (chunk->chunk_x != chunk_x || chunk->chunk_z != chunk_z || chunk->state < CHUNK_LOADED)
+        return lod;
+
+    return chunk->level > lod ? chunk->level : lod;
+}
+
+void update_terrain(terrain_t *terrain, vec3 pos, vec3 velocity, vec3 look) {
+    vec3_set(terrain->position, pos[0], pos[1], pos[2]);
+    vec3_set(terrain->velocity, velocity[0], velocity[1], velocity[2]);
+    vec3_set(terrain->look, look[0], look[1], look[2]);
+
+    // The center chunk spans [x, x + CHUNK_SIZE) by (z - CHUNK_SIZE, z], grown
+    // by the hysteresis margin so jitter across an edge does not re-center
+    float min_x = terrain->center_chunk_x * CHUNK_SIZE - terrain->hysteresis;
+    float max_x = (terrain->center_chunk_x + 1) * CHUNK_SIZE + terrain->hysteresis;
+    float min_z = (terrain->center_chunk_z - 1) * CHUNK_SIZE - terrain->hysteresis;
+    float max_z = terrain->center_chunk_z * CHUNK_SIZE + terrain->hysteresis;
+
+    if (pos[0] < min_x || pos[0] >= max_x || pos[2] <= min_z || pos[2] > max_z) {
+        terrain->center_chunk_x = (int)floor(pos[0] / CHUNK_SIZE);
+        terrain->center_chunk_z = (int)ceil(pos[2] / CHUNK_SIZE);
+        terrain->recenters++;
     }
+
+    update_chunks(terrain);
 }
 
-float lerp(float a, float b, float t) {
-    return a + (b - a) * t;
+int terrain_raycast(terrain_t *terrain, vec3 origin, vec3 dir, float max_distance, float *distance) {
+    int hit = 0;
+    *distance = max_distance;
+
+    for (int n = 0; n < terrain->chunks_count; n++) {
+        chunk_t *chunk = &terrain->chunks[n];
+        if (chunk->state != CHUNK_LOADED && chunk->state != CHUNK_REFINING)
+            continue;
+
+        cache_entry_t *entry = peek_cached(&terrain->cache, chunk_key(chunk->chunk_x, chunk->level), chunk->chunk_z);
+        if (!entry)
+            continue;
+
+        // Into the chunk's grid space, where z counts rows down from its top edge
+        vec3 local = {origin[0] - chunk->chunk_x * CHUNK_SIZE, origin[1], chunk->chunk_z * CHUNK_SIZE - origin[2]};
+        vec3 local_dir = {dir[0], dir[1], -dir[2]};
+
+        float t;
+        if (raycast_chunk((height_t *)entry->data, chunk->level, local, local_dir, *distance, &t)) {
+            *distance = t;
+            hit = 1;
+        }
+    }
+
+    return hit;
 }
 
-float fade(float t) {
-    return t * t * t * (t * (t * 6 - 15) + 10);
+float terrain_view_distance(terrain_t *terrain) {
+    return terrain->radius * CHUNK_SIZE;
 }
 
-void grad(vec2 v, int xi, int zi) {
-    // https://en.wikipedia.org/wiki/Perlin_noise
+size_t terrain_vertex_bytes(terrain_t *terrain) {
+    return sizeof(height_t) * terrain->slot_vertices * terrain->chunks_count;
+}
 
-    const unsigned int w = 8 * sizeof(unsigned int);
-    const unsigned int s = w / 2;  // rotation width
+int chunk_slot(terrain_t *terrain, int chunk_x, int chunk_z) {
+    // Slots form a toroidal ring: a chunk keeps its slot for as long as it stays in view
+    int side = terrain->side;
+    int x = ((chunk_x % side) + side) % side;
+    int z = ((chunk_z % side) + side) % side;
 
-    unsigned int a = *(unsigned int *)&xi;
-    unsigned int b = *(unsigned int *)&zi;
+    return x + z * side;
+}
 
-    a *= 3284157443;
-    b ^= a << s | a >> (w - s);
-    b *= 1911520717;
-    a ^= b << s | b >> (w - s);
-    a *= 2048419325;
+int chunk_key(int chunk_x, int level) {
+    // Levels share the cache, so they are folded into the key
+    return chunk_x * CHUNK_LODS + level;
+}
+
+cache_entry_t *find_chunk(terrain_t *terrain, int chunk_x, int chunk_z, int lod, int touch, int *level) {
+    // Any level as fine as lod will do. With touch a hit is counted and
+    // marked recently used; a miss is left for the caller to count once it
+    // queues the chunk, so retries while out of buffers are not counted again.
+    for (*level = lod; *level > 0; (*level)--)
+        if (peek_cached(&terrain->cache, chunk_key(chunk_x, *level), chunk_z))
+            break;
+
+    int key = chunk_key(chunk_x, *level);
+    cache_entry_t *entry = peek_cached(&terrain->cache, key, chunk_z);
+
+    return entry && touch ? find_cached(&terrain->cache, key, chunk_z) : entry;
+}
+
+void load_chunk(terrain_t *terrain, int slot, height_t *data, int level, float min_height, float max_height) {
+    chunk_t *chunk = &terrain->chunks[slot];
+
+    double start = get_time();
+    upload_chunk(terrain, slot, data, level);
+    terrain->upload_time += get_time() - start;
+    terrain->chunks_uploaded++;
+
+    chunk->level = level;
+    chunk->min_height = min_height;
+    chunk->max_height = max_height;
+    chunk->state = CHUNK_LOADED;
+}
+
+int submit_chunk(terrain_t *terrain, int chunk_x, int chunk_z, int level, int slot) {
+    job_t *job = acquire_job(&terrain->jobs);
+    if (!job)
+        return 0;
+
+    job->chunk_x = chunk_x;
+    job->chunk_z = chunk_z;
+    job->level = level;
+    job->slot = slot;
+    job->context = &terrain->tiles;
+    job->priority = chunk_priority(terrain, chunk_x, chunk_z, slot >= 0);
+
+    submit_job(&terrain->jobs, job);
+    return 1;
+}
+
+float chunk_priority(terrain_t *terrain, int chunk_x, int chunk_z, int visible) {
+    float *pos = terrain->position, *look = terrain->look;
+
+    float dx = (chunk_x + 0.5f) * CHUNK_SIZE - pos[0];
+    float dz = (chunk_z - 0.5f) * CHUNK_SIZE - pos[2];
+    float distance = sqrtf(dx * dx + dz * dz);
+    float look_xz = sqrtf(look[0] * look[0] + look[2] * look[2]);
+
+    // Distance to the camera, stretched up to 3x for chunks behind it
+    float alignment = distance > 0 && look_xz > 0 ? (dx * look[0] + dz * look[2]) / (distance * look_xz) : 1.0f;
+    float priority = distance * (2.0f - alignment);
+
+    // Prefetches queue behind the whole window
+    return visible ? priority : priority + 3.0f * M_SQRT2 * (terrain->radius + 1) * CHUNK_SIZE;
+}
+
+float score_job(job_t *job, void *arg) {
+    terrain_t *terrain = (terrain_t *)arg;
+
+    int visible = in_window(job->chunk_x, job->chunk_z, terrain->center_chunk_x, terrain->center_chunk_z,
+                            terrain->radius);
+    // Its slot has moved on, nothing would use the result
+    if (job->slot >= 0)
+        return visible ? chunk_priority(terrain, job->chunk_x, job->chunk_z, 1) : -1.0f;
+
+    if (visible)
+        return chunk_priority(terrain, job->chunk_x, job->chunk_z, 1);
+
+    // Prefetches are dropped once the camera heads away from them
+    float *pos = terrain->position, *velocity = terrain->velocity;
+    float dx = (job->chunk_x + 0.5f) * CHUNK_SIZE - pos[0];
+    float dz = (job->chunk_z - 0.5f) * CHUNK_SIZE - pos[2];
+
+    if (dx * velocity[0] + dz * velocity[2] < 0) {
+        remove_prefetch(terrain, job->chunk_x, job->chunk_z);
+        return -1.0f;
+    }
+
+    return chunk_priority(terrain, job->chunk_x, job->chunk_z, 0);
+}
+
+int find_prefetch(terrain_t *terrain, int chunk_x, int chunk_z) {
+    for (int i = 0; i < terrain->prefetch_count; i++)
+        if (terrain->prefetch_x[i] == chunk_x && terrain->prefetch_z[i] == chunk_z)
+            return i;
+
+    return -1;
+}
+
+void remove_prefetch(terrain_t *terrain, int chunk_x, int chunk_z) {
+    int i = find_prefetch(terrain, chunk_x, chunk_z);
+    if (i < 0)
+        return;
+
+    terrain->prefetch_count--;
+    terrain->prefetch_x[i] = terrain->prefetch_x[terrain->prefetch_count];
+    terrain->prefetch_z[i] = terrain->prefetch_z[terrain->prefetch_count];
+}
+
+int in_window(int chunk_x, int chunk_z, int center_x, int center_z, int radius) {
+    return abs(chunk_x - center_x) <= radius && abs(chunk_z - center_z) <= radius;
+}
+
+int compare_prefetch(const void *a, const void *b) {
+    const prefetch_t *p = (const prefetch_t *)a;
+    const prefetch_t *q = (const prefetch_t *)b;
+
+    // Soonest needed first, then closest to where the camera is looking
+    if (p->time != q->time)
+        return p->time < q->time ? -1 : 1;
+
+    return (p->alignment < q->alignment) - (p->alignment > q->alignment);
+}
+
+void update_chunks(terrain_t *terrain) {
+    job_t *job;
+    cache_entry_t *entry;
+
+    if (terrain->jobs.threads_count == 0)
+        generate_in_budget(terrain);
+
+    // Upload finished chunks, dropping any whose slot has since moved on
+    while ((job = collect_job(&terrain->jobs))) {
+        int slot = chunk_slot(terrain, job->chunk_x, job->chunk_z);
+        chunk_t *chunk = &terrain->chunks[slot];
 
-    float r = a * (M_PI / ~(~0u >> 1));  // in [0, 2*Pi]
-    vec2_set(v, sinf(r), cosf(r));
+        if (!job->loaded) {
+            int side = CHUNK_MIP_SIDE(job->level);
+
+            terrain->chunks_generated++;
+            terrain->generate_time += job->time;
+            terrain->level_chunks[job->level]++;
+            terrain->level_samples[job->level] += side * side;
+            terrain->level_time[job->level] += job->time;
+        }
+
+        // Cache every result, a dropped chunk is the one most likely to be
+        // revisited. Only from the level it was sampled at, the rest is stale.
+        if ((entry = insert_cached(&terrain->cache, chunk_key(job->chunk_x, job->level), job->chunk_z))) {
+            size_t first = sizeof(height_t) * chunk_mip_offset(job->level);
+            memcpy((char *)entry->data + first, (char *)job->data + first, terrain->cache.entry_size - first);
+            entry->min_height = job->min_height;
+            entry->max_height = job->max_height;
+        }
+
+        // Prefetched chunks have no slot, but may have entered the window since
+        if (job->slot < 0) {
+            remove_prefetch(terrain, job->chunk_x, job->chunk_z);
+            terrain->chunks_prefetched++;
+        }
+
+        int refines = chunk->state == CHUNK_REFINING && job->level < chunk->level;
+
+        if ((chunk->state == CHUNK_QUEUED || refines) && chunk->chunk_x == job->chunk_x &&
+            chunk->chunk_z == job->chunk_z)
+            load_chunk(terrain, slot, (height_t *)job->data, job->level, job->min_height, job->max_height);
+        else if (job->slot >= 0)
+            terrain->chunks_discarded++;
+
+        release_job(&terrain->jobs, job);
+    }
+
+    // Reorder queued work for the camera as it is now, dropping what it no longer needs
+    terrain->chunks_cancelled += rescore_jobs(&terrain->jobs, score_job, terrain);
+
+    // The window comes first, prefetching only gets buffers it left over
+    if (request_chunks(terrain))
+        prefetch_chunks(terrain);
+
+    end_staging_frame(&terrain->staging);
 }
 
-float noise(float x, float z) {
-    int xd = (x < 0) ? -1 : 1;
-    int zd = (z < 0) ? -1 : 1;
+int request_chunks(terrain_t *terrain) {
+    int radius = terrain->radius;
+
+    for (int x = -radius; x <= radius; x++)
+        for (int z = -radius; z <= radius; z++) {
+            int chunk_x = terrain->center_chunk_x + x;
+            int chunk_z = terrain->center_chunk_z + z;
 
-    int xi = (int)x / GRID_SIZE;
-    int zi = (int)z / GRID_SIZE;
+            int slot = chunk_slot(terrain, chunk_x, chunk_z);
+            chunk_t *chunk = &terrain->chunks[slot];
+            int lod = chunk_lod(terrain, chunk_x, chunk_z), level;
+
+            if (chunk->chunk_x != chunk_x || chunk->chunk_z != chunk_z) {
+                chunk->chunk_x = chunk_x;
+                chunk->chunk_z = chunk_z;
+                chunk->state = CHUNK_EMPTY;
+            }
 
-    if (xd == -1) xi--;
-    if (zd == -1) zi--;
+            // Sampled coarser than it is now drawn after a re-center: keep it
+            // on screen while the finer level is generated
+            int refine = chunk->state == CHUNK_LOADED && chunk->level > lod;
 
-    vec2 controls[4];
-    grad(controls[0], xi + 0, zi + 0);
-    grad(controls[1], xi + 1, zi + 0);
-    grad(controls[2], xi + 0, zi + 1);
-    grad(controls[3], xi + 1, zi + 1);
+            if (chunk->state != CHUNK_EMPTY && !refine)
+                continue;
 
-    float xf, zf;
-    if (xd == 1)
-        xf = (x - xi * GRID_SIZE) / GRID_SIZE;
-    else
-        xf = 1 - ((fabs(x) + GRID_SIZE) + xi * GRID_SIZE) / GRID_SIZE;
+            cache_entry_t *entry = find_chunk(terrain, chunk_x, chunk_z, lod, 1, &level);
+            if (entry) {
+                load_chunk(terrain, slot, (height_t *)entry->data, level, entry->min_height, entry->max_height);
+                continue;
+            }
 
-    if (zd == 1)
-        zf = (z - zi * GRID_SIZE) / GRID_SIZE;
-    else
-        zf = 1 - ((fabs(z) + GRID_SIZE) + zi * GRID_SIZE) / GRID_SIZE;
+            if (refine) {
+                if (!submit_chunk(terrain, chunk_x, chunk_z, lod, slot))
+                    return 0;
 
-    vec2 p;
-    vec2_set(p, xf, zf);
+                miss_cached(&terrain->cache);
+                chunk->state = CHUNK_REFINING;
+                continue;
+            }
 
-    vec2 offsets[4];
-    vec2_sub(offsets[0], p, (vec2){0.0f, 0.0f});
-    vec2_sub(offsets[1], p, (vec2){1.0f, 0.0f});
-    vec2_sub(offsets[2], p, (vec2){0.0f, 1.0f});
-    vec2_sub(offsets[3], p, (vec2){1.0f, 1.0f});
+            // Already being prefetched: wait for that job instead of queueing another
+            if (find_prefetch(terrain, chunk_x, chunk_z) >= 0) {
+                miss_cached(&terrain->cache);
+                chunk->state = CHUNK_QUEUED;
+                continue;
+            }
 
-    float u0, v0, uv0;
-    u0 = vec2_dot(offsets[0], controls[0]);
-    v0 = vec2_dot(offsets[1], controls[1]);
-    uv0 = lerp(u0, v0, fade(xf));
+            // Out of buffers: try again next frame
+            if (!submit_chunk(terrain, chunk_x, chunk_z, lod, slot))
+                return 0;
 
-    float u1, v1, uv1;
-    u1 = vec2_dot(offsets[2], controls[2]);
-    v1 = vec2_dot(offsets[3], controls[3]);
-    uv1 = lerp(u1, v1, fade(xf));
+            miss_cached(&terrain->cache);
+            chunk->state = CHUNK_QUEUED;
+        }
 
-    return lerp(uv0, uv1, fade(zf));
+    return 1;
+}
+
+void prefetch_chunks(terrain_t *terrain) {
+    float *pos = terrain->position, *velocity = terrain->velocity, *look = terrain->look;
+    float speed = sqrtf(velocity[0] * velocity[0] + velocity[2] * velocity[2]);
+
+    // Prefetched chunks only live in the cache
+    if (terrain->prefetch_horizon <= 0 || terrain->cache.capacity == 0 || speed < 1.0f)
+        return;
+
+    prefetch_t candidates[MAX_PREFETCH_CANDIDATES];
+    int count = 0, radius = terrain->radius, level;
+
+    // Chunks enter at the edge of the window, at its coarsest level
+    int lod = distance_lod(terrain, radius);
+
+    // Follow the predicted path half a chunk at a time, collecting the chunks
+    // each predicted window adds over the one before it
+    float step = CHUNK_SIZE / 2 / speed;
+    int last_x = terrain->center_chunk_x, last_z = terrain->center_chunk_z;
+
+    for (float t = step; t <= terrain->prefetch_horizon; t += step) {
+        int center_x = (int)floor((pos[0] + velocity[0] * t) / CHUNK_SIZE);
+        int center_z = (int)ceil((pos[2] + velocity[2] * t) / CHUNK_SIZE);
+
+        if (center_x == last_x && center_z == last_z)
+            continue;
+
+        for (int x = center_x - radius; x <= center_x + radius; x++)
+            for (int z = center_z - radius; z <= center_z + radius; z++) {
+                if (in_window(x, z, last_x, last_z, radius) ||
+                    in_window(x, z, terrain->center_chunk_x, terrain->center_chunk_z, radius))
+                    continue;
+
+                if (count == MAX_PREFETCH_CANDIDATES)
+                    break;
+
+                float dx = (x + 0.5f) * CHUNK_SIZE - pos[0];
+                float dz = (z - 0.5f) * CHUNK_SIZE - pos[2];
+                float length = sqrtf(dx * dx + dz * dz);
+
+                prefetch_t *candidate = &candidates[count++];
+                candidate->chunk_x = x;
+                candidate->chunk_z = z;
+                candidate->time = t;
+                candidate->alignment = length > 0 ? (dx * look[0] + dz * look[2]) / length : 0;
+            }
+
+        last_x = center_x;
+        last_z = center_z;
+    }
+
+    qsort(candidates, count, sizeof(prefetch_t), compare_prefetch);
+
+    for (int i = 0; i < count && terrain->prefetch_count < MAX_PREFETCH; i++) {
+        prefetch_t *candidate = &candidates[i];
+
+        if (find_chunk(terrain, candidate->chunk_x, candidate->chunk_z, lod, 0, &level) ||
+            find_prefetch(terrain, candidate->chunk_x, candidate->chunk_z) >= 0)
+            continue;
+
+        if (!submit_chunk(terrain, candidate->chunk_x, candidate->chunk_z, lod, -1))
+            return;
+
+        terrain->prefetch_x[terrain->prefetch_count] = candidate->chunk_x;
+        terrain->prefetch_z[terrain->prefetch_count] = candidate->chunk_z;
+        terrain->prefetch_count++;
+    }
 }
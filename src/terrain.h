@@ -2,20 +2,132 @@
 #define TERRAIN_H
 
 #include "glfw.h"
+#include "cache.h"
+#include "heightfield.h"
+#include "frustum.h"
+#include "jobs.h"
 #include "linmath.h"
+#include "staging.h"
+#include "tiles.h"
+
+#define MIN_RADIUS 1
+#define MAX_RADIUS 16  // 33x33 chunks
+#define MAX_JOB_BUFFERS 128
+#define DEFAULT_CACHE_MB 64
+#define DEFAULT_HYSTERESIS 16.0f
+#define DEFAULT_BUDGET_US 2000
+#define DEFAULT_PREFETCH_HORIZON 2.0f
+#define MAX_PREFETCH 16
+#define STAGING_CHUNKS 8  // chunk uploads per staging segment
+#define CHUNK_LOD_DISTANCE 2  // chunks from the center drawn at full resolution with LOD on
+
+enum {
+    CHUNK_EMPTY,
+    CHUNK_QUEUED,
+    CHUNK_LOADED,
+    CHUNK_REFINING,  // loaded, and drawn while a finer level is generated
+};
+
+enum {
+    LOD_OFF,     // every chunk at full resolution
+    LOD_SKIRTS,  // coarser further out, cracks covered by a skirt hanging from each edge
+    LOD_STITCH,  // coarser further out, edges next to a coarser chunk drawn to match it
+};
+
+struct _chunk_t {
+    int chunk_x, chunk_z;
+    int state;
+    int level;  // first pyramid level its samples hold, above 0 when sampled directly that coarse
+
+    float min_height, max_height;
+};
+
+typedef struct _chunk_t chunk_t;
+
+struct _terrain_options_t {
+    int radius;
+    float hysteresis;       // distance past a chunk edge before re-centering
+    size_t cache_bytes;     // in-memory chunk cache budget, 0 disables it
+    const char *tiles_dir;  // on-disk tile cache, NULL disables it
+
+    int threads;    // generation workers, -1 for one per spare core, 0 for none
+    int budget_us;  // render thread generation time per frame when there are no workers
+
+    float prefetch_horizon;  // seconds of predicted motion to generate ahead for, 0 disables it
+
+    int lod;  // LOD_OFF, LOD_SKIRTS or LOD_STITCH
+
+    gl_proc_loader_t get_proc;  // enables persistently mapped uploads when available
+};
+
+typedef struct _terrain_options_t terrain_options_t;
 
 struct _terrain_t {
     int center_chunk_x, center_chunk_z;
+    float hysteresis;
+
+    // View window of side x side chunks around the center
+    int radius, side, chunks_count;
+    chunk_t *chunks;
+
+    job_pool_t jobs;
+    job_t *partial;  // chunk being generated a few rows per frame without workers
+    int budget_us;
+
+    // Chunks about to enter the window given the camera motion, generated into the cache
+    vec3 position, velocity, look;
+    float prefetch_horizon;
+    int prefetch_count;
+    int prefetch_x[MAX_PREFETCH], prefetch_z[MAX_PREFETCH];
+    cache_t cache;  // recently generated chunks, including ones that left the window
+    tiles_t tiles;
+
+    // Index ranges in ebo per level of detail and set of coarser neighbours,
+    // only [0][0] with LOD off and only [lod][0] with skirts
+    int lod;
+    int grid_vertices;  // per chunk: its heights, plus the averaged levels drawn with LOD on
+    int slot_vertices;  // grid_vertices plus skirts
+    int lod_offset[CHUNK_LODS][CHUNK_STITCH_VARIANTS], lod_count[CHUNK_LODS][CHUNK_STITCH_VARIANTS];
+    size_t index_bytes;
+
+    // Draw statistics for the last frame, grid_indices counting the plain
+    // grids alone to show what skirts or stitching add
+    int chunks_drawn, chunks_culled;
+    int indices_drawn, grid_indices_drawn;
+
+    // Totals since init: generate_time is worker time, upload_time is GL thread time
+    int chunks_generated, chunks_uploaded, chunks_discarded, chunks_prefetched, chunks_cancelled, recenters;
+    double generate_time, upload_time;
+
+    // The same per level chunks were sampled at, all at level 0 with LOD off
+    int level_chunks[CHUNK_LODS];
+    long level_samples[CHUNK_LODS];
+    double level_time[CHUNK_LODS];
 
     GLuint vao, vbo, ebo;
+    staging_t staging;
 };
 
 typedef struct _terrain_t terrain_t;
 
-void init_terrain(terrain_t *terrain);
-void draw_terrain(terrain_t *terrain);
+void default_terrain_options(terrain_options_t *options);
+
+int parse_chunk_lod(const char *name);
+const char *chunk_lod_name(int lod);
+
+void init_terrain(terrain_t *terrain, const terrain_options_t *options);
+void draw_terrain(terrain_t *terrain, GLuint shader, frustum_t frustum);
 void free_terrain(terrain_t *terrain);
 
-void update_terrain(terrain_t *terrain, vec3 pos);
+// velocity in units per second and the look direction steer prefetching
+void update_terrain(terrain_t *terrain, vec3 pos, vec3 velocity, vec3 look);
+
+// Nearest hit along origin + t * dir with t up to max_distance, dir being a
+// unit vector. Only chunks in the window that are still in the cache are
+// tested. Returns 1 and sets distance on a hit.
+int terrain_raycast(terrain_t *terrain, vec3 origin, vec3 dir, float max_distance, float *distance);
+
+float terrain_view_distance(terrain_t *terrain);
+size_t terrain_vertex_bytes(terrain_t *terrain);
 
 #endif  // TERRAIN_H
@@ -0,0 +1,149 @@
+#include "tiles.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "heightfield.h"
+
+void tile_path(tiles_t *tiles, char *path, size_t size, int chunk_x, int chunk_z, int level);
+void fill_header(tiles_t *tiles, tile_header_t *header, int chunk_x, int chunk_z, int level, int samples);
+
+void init_tiles(tiles_t *tiles, const char *dir, size_t sample_bytes, int samples) {
+    tiles->dir = NULL;
+    tiles->sample_bytes = sample_bytes;
+    tiles->data_size = sample_bytes * samples;
+    tiles->loaded = tiles->stored = tiles->rejected = 0;
+
+    if (!dir)
+        return;
+
+    if (mkdir(dir, 0755) != 0 && errno != EEXIST) {
+        fprintf(stderr, "Error: unable to create tile directory %s\n", dir);
+        exit(EXIT_FAILURE);
+    }
+
+    tiles->dir = strdup(dir);
+}
+
+void free_tiles(tiles_t *tiles) {
+    free(tiles->dir);
+}
+
+int load_tile(tiles_t *tiles, int chunk_x, int chunk_z, int level, void *data, int samples, float *min_height,
+              float *max_height) {
+    size_t data_size = tiles->sample_bytes * samples;
+
+    if (!tiles->dir || data_size > tiles->data_size)
+        return 0;
+
+    char path[4096];
+    tile_path(tiles, path, sizeof(path), chunk_x, chunk_z, level);
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return 0;
+
+    struct stat st;
+    size_t size = sizeof(tile_header_t) + data_size;
+
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size != size) {
+        close(fd);
+        __atomic_add_fetch(&tiles->rejected, 1, __ATOMIC_RELAXED);
+        return 0;
+    }
+
+    // The copy out of the mapping is the read, the kernel pages the file in
+    void *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (map == MAP_FAILED)
+        return 0;
+
+    tile_header_t expected;
+    fill_header(tiles, &expected, chunk_x, chunk_z, level, samples);
+
+    tile_header_t *header = (tile_header_t *)map;
+    int valid = !memcmp(header, &expected, offsetof(tile_header_t, min_height));
+
+    if (valid) {
+        memcpy(data, header + 1, data_size);
+        *min_height = header->min_height;
+        *max_height = header->max_height;
+    }
+
+    munmap(map, size);
+
+    __atomic_add_fetch(valid ? &tiles->loaded : &tiles->rejected, 1, __ATOMIC_RELAXED);
+    return valid;
+}
+
+int store_tile(tiles_t *tiles, int chunk_x, int chunk_z, int level, const void *data, int samples,
+               float min_height, float max_height) {
+    size_t data_size = tiles->sample_bytes * samples;
+
+    if (!tiles->dir || data_size > tiles->data_size)
+        return 0;
+
+    char path[4096], tmp_path[4096 + 8];
+    tile_path(tiles, path, sizeof(path), chunk_x, chunk_z, level);
+    snprintf(tmp_path, sizeof(tmp_path), "%s.XXXXXX", path);
+
+    tile_header_t header;
+    fill_header(tiles, &header, chunk_x, chunk_z, level, samples);
+    header.min_height = min_height;
+    header.max_height = max_height;
+
+    // Write aside and rename, readers never see a partial tile
+    int fd = mkstemp(tmp_path);
+    if (fd < 0)
+        return 0;
+
+    int ok = write(fd, &header, sizeof(header)) == (ssize_t)sizeof(header) &&
+             write(fd, data, data_size) == (ssize_t)data_size;
+
+    ok = close(fd) == 0 && ok && rename(tmp_path, path) == 0;
+
+    if (!ok) {
+        unlink(tmp_path);
+        return 0;
+    }
+
+    __atomic_add_fetch(&tiles->stored, 1, __ATOMIC_RELAXED);
+    return 1;
+}
+
+void tile_path(tiles_t *tiles, char *path, size_t size, int chunk_x, int chunk_z, int level) {
+    snprintf(path, size, "%s/%d_%d_%d.tile", tiles->dir, chunk_x, chunk_z, level);
+}
+
+void fill_header(tiles_t *tiles, tile_header_t *header, int chunk_x, int chunk_z, int level, int samples) {
+    // Zeroed so the padding compares equal too
+    memset(header, 0, sizeof(*header));
+
+    header->magic = TILE_MAGIC;
+    header->version = TILE_VERSION;
+
+    header->seed = noise_seed();
+    header->chunk_size = CHUNK_SIZE;
+    header->grid_size = GRID_SIZE;
+    strncpy(header->gradients, noise_gradients(), sizeof(header->gradients) - 1);
+
+    fractal_t fractal;
+    get_fractal(&fractal);
+    header->fractal = fractal.type;
+    header->octaves = fractal.octaves;
+    header->lacunarity = fractal.lacunarity;
+    header->gain = fractal.gain;
+    header->sample_bytes = (int32_t)tiles->sample_bytes;
+    header->samples = samples;
+
+    header->chunk_x = chunk_x;
+    header->chunk_z = chunk_z;
+    header->level = level;
+}
@@ -0,0 +1,56 @@
+#ifndef TILES_H
+#define TILES_H
+
+// On-disk cache of generated chunks, part of libterrain. Each chunk is one
+// file holding a header and its encoded samples: heights and whatever the
+// caller keeps next to them; tiles whose header does not
+// match the current generator are ignored and rewritten. Safe to use from
+// worker threads.
+
+#include <stddef.h>
+#include <sys/types.h>
+
+#define TILE_MAGIC 0x454c4954  // "TILE"
+#define TILE_VERSION 4
+
+struct _tile_header_t {
+    u_int32_t magic, version;
+
+    // Everything the heights depend on
+    u_int32_t seed;
+    int32_t chunk_size, grid_size;
+    char gradients[16];
+    int32_t fractal, octaves;
+    float lacunarity, gain;
+    int32_t sample_bytes, samples;
+
+    int32_t chunk_x, chunk_z, level;
+    float min_height, max_height;
+};
+
+typedef struct _tile_header_t tile_header_t;
+
+struct _tiles_t {
+    char *dir;  // NULL when disabled
+    size_t sample_bytes, data_size;
+
+    // Totals since init, updated atomically
+    int loaded, stored, rejected;
+};
+
+typedef struct _tiles_t tiles_t;
+
+// Creates dir if needed, a NULL dir disables the tile cache. Tiles hold up to
+// samples values of sample_bytes each.
+void init_tiles(tiles_t *tiles, const char *dir, size_t sample_bytes, int samples);
+void free_tiles(tiles_t *tiles);
+
+// Both return 1 on success, 0 on a missing or stale tile or a failed write.
+// Each level a chunk is generated at is a tile of its own, of samples values:
+// only what that level fills in.
+int load_tile(tiles_t *tiles, int chunk_x, int chunk_z, int level, void *data, int samples, float *min_height,
+              float *max_height);
+int store_tile(tiles_t *tiles, int chunk_x, int chunk_z, int level, const void *data, int samples,
+               float min_height, float max_height);
+
+#endif  // TILES_H
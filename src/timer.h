@@ -0,0 +1,14 @@
+#ifndef TIMER_H
+#define TIMER_H
+
+#include <time.h>
+
+// Monotonic wall clock in seconds, usable without a window or GL context
+static inline double get_time() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+#endif  // TIMER_H